@@ -0,0 +1,72 @@
+#include "Arena.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Size of a regular block, bigger requests get a block of their own
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+static const size_t ALIGNMENT = alignof(max_align_t);
+
+static size_t alignUp(size_t size) {
+  return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+Arena::Arena()
+    : cursor(nullptr), limit(nullptr), blocks(nullptr), finalizers(nullptr),
+      allocated(0) {}
+
+Arena::~Arena() {
+  // Destroy in reverse allocation order, like the stack would
+  for (Finalizer *f = finalizers; f != nullptr; f = f->next)
+    f->destroy(reinterpret_cast<char *>(f) + alignUp(sizeof(Finalizer)));
+
+  while (blocks != nullptr) {
+    Block *next = blocks->next;
+    free(blocks);
+    blocks = next;
+  }
+}
+
+void *Arena::allocate(size_t size) {
+  size = alignUp(size);
+  if ((size_t)(limit - cursor) < size)
+    grow(size);
+
+  void *ptr = cursor;
+  cursor += size;
+  allocated += size;
+  return ptr;
+}
+
+void *Arena::allocate(size_t size, void (*destroy)(void *)) {
+  // The finalizer record sits right before the object it destroys
+  char *ptr = static_cast<char *>(allocate(alignUp(sizeof(Finalizer)) + size));
+
+  Finalizer *finalizer = reinterpret_cast<Finalizer *>(ptr);
+  finalizer->next = finalizers;
+  finalizer->destroy = destroy;
+  finalizers = finalizer;
+
+  return ptr + alignUp(sizeof(Finalizer));
+}
+
+size_t Arena::bytesAllocated() { return allocated; }
+
+void Arena::grow(size_t size) {
+  size_t header = alignUp(sizeof(Block));
+  size_t blockSize = size + header > ARENA_BLOCK_SIZE ? size + header
+                                                      : ARENA_BLOCK_SIZE;
+
+  Block *block = static_cast<Block *>(malloc(blockSize));
+  if (block == nullptr)
+    throw std::bad_alloc();
+
+  block->next = blocks;
+  block->size = blockSize;
+  blocks = block;
+
+  cursor = reinterpret_cast<char *>(block) + header;
+  limit = reinterpret_cast<char *>(block) + blockSize;
+}
@@ -0,0 +1,40 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+
+// Bump pointer allocator. Memory is handed out from large blocks and only
+// released all at once when the Arena is destroyed, objects that need it get
+// their destructor run at that point too
+class Arena {
+public:
+  Arena();
+  ~Arena();
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  void *allocate(size_t size);
+  void *allocate(size_t size, void (*destroy)(void *));
+  size_t bytesAllocated();
+
+private:
+  struct Block {
+    Block *next;
+    size_t size;
+  };
+
+  struct Finalizer {
+    Finalizer *next;
+    void (*destroy)(void *);
+  };
+
+  char *cursor;
+  char *limit;
+  Block *blocks;
+  Finalizer *finalizers;
+  size_t allocated;
+
+  void grow(size_t size);
+};
+
+#endif
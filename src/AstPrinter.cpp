@@ -21,7 +21,7 @@ string AstPrinter::parenthesize(string name, vector<Expr<string> *> exprs) {
 }
 
 string AstPrinter::visitExprBinary(Binary<string> *expr) {
-  return parenthesize(expr->op.lexeme, {expr->left, expr->right});
+  return parenthesize(string(expr->op.lexeme), {expr->left, expr->right});
 }
 
 string AstPrinter::visitExprGrouping(Grouping<string> *expr) {
@@ -29,12 +29,12 @@ string AstPrinter::visitExprGrouping(Grouping<string> *expr) {
 }
 
 string AstPrinter::visitExprLiteral(Literal<string> *expr) {
-  if (holds_alternative<monostate>(expr->value))
+  if (expr->value.isNil())
     return "nil";
   else
     return to_string(expr->value);
 }
 
 string AstPrinter::visitExprUnary(Unary<string> *expr) {
-  return parenthesize(expr->op.lexeme, {expr->right});
+  return parenthesize(string(expr->op.lexeme), {expr->right});
 }
@@ -0,0 +1,144 @@
+#include "CacheStream.h"
+
+#include <cstring>
+
+#include "Interner.h"
+
+using namespace std;
+
+// Tags of literal values
+enum CacheValue { VALUE_NIL, VALUE_FALSE, VALUE_TRUE, VALUE_NUMBER, VALUE_STRING };
+
+// ----------------------------------------
+// Writer function definitions
+CacheWriter::CacheWriter(string_view src) : src(src) {}
+
+void CacheWriter::u8(uint8_t value) { bytes.push_back(value); }
+
+void CacheWriter::u32(uint32_t value) {
+  for (int i = 0; i < 4; i++)
+    bytes.push_back(value >> (8 * i));
+}
+
+void CacheWriter::u64(uint64_t value) {
+  for (int i = 0; i < 8; i++)
+    bytes.push_back(value >> (8 * i));
+}
+
+void CacheWriter::write(const Token &token) {
+  // Every token of a parsed script comes from the Lexer, so its lexeme is a
+  // piece of the source
+  size_t offset = token.lexeme.data() - src.data();
+  if (token.lexeme.data() < src.data() ||
+      offset + token.lexeme.size() > src.size())
+    throw CacheError("token outside of the source");
+
+  u8(token.type);
+  u32(offset);
+  u32(token.lexeme.size());
+  u32(token.line);
+}
+
+void CacheWriter::write(Obj value) {
+  if (value.isNumber()) {
+    uint64_t bits;
+    double number = value.asNumber();
+    memcpy(&bits, &number, sizeof(double));
+    u8(VALUE_NUMBER);
+    u64(bits);
+  } else if (value.isString()) {
+    const string &text = value.asString()->value;
+    u8(VALUE_STRING);
+    u32(text.size());
+    bytes.insert(bytes.end(), text.begin(), text.end());
+  } else if (value.isBool()) {
+    u8(value.asBool() ? VALUE_TRUE : VALUE_FALSE);
+  } else if (value.isNil()) {
+    u8(VALUE_NIL);
+  } else {
+    throw CacheError("literal can't be cached");
+  }
+}
+
+void CacheWriter::write(int value) { u32(value); }
+
+// ----------------------------------------
+// Reader function definitions
+CacheReader::CacheReader(const uint8_t *data, size_t size, string_view src)
+    : pos(data), end(data + size), src(src) {}
+
+void CacheReader::fail() { throw CacheError("corrupt cache"); }
+
+bool CacheReader::atEnd() { return pos == end; }
+
+uint8_t CacheReader::u8() {
+  if (pos == end)
+    fail();
+  return *pos++;
+}
+
+uint32_t CacheReader::u32() {
+  if (end - pos < 4)
+    fail();
+
+  uint32_t value = 0;
+  for (int i = 0; i < 4; i++)
+    value |= (uint32_t)*pos++ << (8 * i);
+  return value;
+}
+
+uint64_t CacheReader::u64() {
+  if (end - pos < 8)
+    fail();
+
+  uint64_t value = 0;
+  for (int i = 0; i < 8; i++)
+    value |= (uint64_t)*pos++ << (8 * i);
+  return value;
+}
+
+Token CacheReader::token() {
+  uint8_t type = u8();
+  uint32_t offset = u32();
+  uint32_t length = u32();
+  uint32_t line = u32();
+  if (type > EOF_TOK || offset > src.size() || length > src.size() - offset)
+    fail();
+
+  // Same token the Lexer would have made, identifiers get their symbol back
+  // from this process' Interner
+  Token token((TokenType)type, src.substr(offset, length), monostate(), line);
+  if (token.type == IDENTIFIER)
+    token.symbol = interner().symbol(token.lexeme);
+  return token;
+}
+
+Obj CacheReader::value() {
+  switch (u8()) {
+  case VALUE_NIL:
+    return monostate();
+  case VALUE_FALSE:
+    return false;
+  case VALUE_TRUE:
+    return true;
+  case VALUE_NUMBER: {
+    uint64_t bits = u64();
+    double number;
+    memcpy(&number, &bits, sizeof(double));
+    return number;
+  }
+  case VALUE_STRING: {
+    uint32_t length = u32();
+    if ((size_t)(end - pos) < length)
+      fail();
+
+    // Pinned like the Lexer's literals, the AST refers to it directly
+    StringObj *text = newString(string_view((const char *)pos, length));
+    text->pinned = true;
+    pos += length;
+    return text;
+  }
+  default:
+    fail();
+  }
+}
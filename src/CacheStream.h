@@ -0,0 +1,55 @@
+#ifndef CACHE_STREAM_H
+#define CACHE_STREAM_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "Lex.h"
+#include "Util.h"
+
+using namespace std;
+
+// A cache that can't be written or read back, the script is parsed instead
+class CacheError : public runtime_error {
+public:
+  CacheError(const string &message) : runtime_error(message) {}
+};
+
+// Little endian encoding of the values gen/AstCache.hpp writes. Token
+// lexemes are stored as offsets into the source, which the cache is only
+// used with when its hash matches
+class CacheWriter {
+public:
+  vector<uint8_t> bytes;
+  CacheWriter(string_view src);
+  void u8(uint8_t value);
+  void u32(uint32_t value);
+  void u64(uint64_t value);
+  void write(const Token &token);
+  void write(Obj value);
+  void write(int value);
+
+private:
+  string_view src;
+};
+
+class CacheReader {
+public:
+  CacheReader(const uint8_t *data, size_t size, string_view src);
+  uint8_t u8();
+  uint32_t u32();
+  uint64_t u64();
+  Token token();
+  Obj value();
+  bool atEnd();
+  [[noreturn]] void fail();
+
+private:
+  const uint8_t *pos;
+  const uint8_t *end;
+  string_view src;
+};
+
+#endif
@@ -1,17 +1,21 @@
 #include "Callable.h"
 
-#include "Return.h"
 #include <chrono>
 #include <iostream>
 #include <string>
 
+#include "Gc.h"
+#include "Jit.h"
+#include "Parser.h"
+#include "Resolver.h"
+
 using namespace std::chrono;
 using std::string;
 
 // Clock native function stuff
 int ClockCallable::arity() { return 0; }
 
-Obj ClockCallable::call(Interpreter &interpreter, list<Obj> arguments) {
+Obj ClockCallable::call(list<Obj> arguments) {
   double time =
       duration_cast<milliseconds>(system_clock::now().time_since_epoch())
           .count() /
@@ -22,32 +26,58 @@ Obj ClockCallable::call(Interpreter &interpreter, list<Obj> arguments) {
 string ClockCallable::to_string() { return "<native fn>"; }
 
 // Function stuff
-FunctionCallable::FunctionCallable(Function<Obj> *declaration,
+FunctionCallable::FunctionCallable(Interpreter &interpreter,
+                                   Function<Obj> *declaration,
                                    Environment *closure)
-    : declaration(declaration), closure(closure) {}
+    : closure(closure), interpreter(interpreter), declaration(declaration) {}
 
-Obj FunctionCallable::call(Interpreter &interpreter, list<Obj> arguments) {
-  auto env = new Environment(closure);
+// Parses and resolves a body the Parser deferred, then keeps it
+static void parseBody(Function<Obj> *declaration) {
+  LazyBody *lazy = declaration->lazy;
+  if (!lazy->failed) {
+    Parser<Obj> parser(*lazy->tokens, *lazy->arena);
+    declaration->body = parser.parseBody(*lazy);
+    declaration->lazy = nullptr;
 
-  auto param_itr = declaration->params.begin();
-  auto args_itr = arguments.begin();
-  for (size_t i = 0; i < declaration->params.size(); i++) {
-    env->define((*param_itr).lexeme, (*args_itr));
-    param_itr++;
-    args_itr++;
-  }
+    Resolver resolver;
+    if (!parser.err)
+      resolver.resolve(vector<Stmt<Obj> *>{declaration});
+    if (!parser.err && !resolver.err)
+      return;
 
-  try {
-    interpreter.executeBlock(declaration->body, env);
-  } catch (const ReturnError &ret) {
-    return ret.value;
+    declaration->lazy = lazy;
+    lazy->failed = true;
   }
 
-  return monostate();
+  throw BodyError("Can't call '" + string(declaration->name.lexeme) +
+                  "', its body has errors.");
+}
+
+Obj FunctionCallable::call(list<Obj> arguments) {
+  if (declaration->lazy)
+    parseBody(declaration);
+
+  // Hot functions are compiled once, on the call that reaches the threshold
+  Jit &compiler = jit();
+  if (compiler.enabled && !declaration->native &&
+      declaration->calls < compiler.threshold &&
+      ++declaration->calls == compiler.threshold)
+    declaration->native = compiler.compile(declaration);
+
+  Obj result;
+  if (declaration->native &&
+      compiler.run(declaration->native, arguments, result))
+    return result;
+
+  return interpreter.callFunction(closure, arguments, [&](Environment *env) {
+    return interpreter.executeBlock(declaration->body, env);
+  });
 }
 
+void FunctionCallable::trace(Gc &gc) { gc.markObject(closure); }
+
 int FunctionCallable::arity() { return declaration->params.size(); }
 
 string FunctionCallable::to_string() {
-  return "<fn " + declaration->name.lexeme;
+  return "<fn " + string(declaration->name.lexeme);
 }
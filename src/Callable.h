@@ -4,28 +4,41 @@
 #include "Interpreter.h"
 #include "Util.h"
 
-class Callable {
+// Callables carry whatever engine state they need, so natives can be shared
+// by the tree Interpreter and the bytecode VM
+class Callable : public HeapObj {
 public:
+  Callable() : HeapObj(OBJ_CALLABLE) {}
   virtual int arity() = 0;
-  virtual Obj call(Interpreter &interpreter, list<Obj> arguments) = 0;
+  virtual Obj call(list<Obj> arguments) = 0;
   virtual string to_string() = 0;
 };
 
 class ClockCallable : public Callable {
   int arity() override;
-  Obj call(Interpreter &interpreter, list<Obj> arguments) override;
+  Obj call(list<Obj> arguments) override;
   string to_string() override;
 };
 
+// Thrown by FunctionCallable::call when the function's deferred body has
+// errors, the Interpreter reports it at the call site
+class BodyError : public runtime_error {
+public:
+  BodyError(string message) : runtime_error(message) {}
+};
+
 class FunctionCallable : public Callable {
 public:
   int arity() override;
-  Obj call(Interpreter &interpreter, list<Obj> arguments) override;
+  Obj call(list<Obj> arguments) override;
   string to_string() override;
   Environment* closure;
-  FunctionCallable(Function<Obj> *declaration, Environment* closure);
+  FunctionCallable(Interpreter &interpreter, Function<Obj> *declaration,
+                   Environment *closure);
+  void trace(Gc &gc) override;
 
 private:
+  Interpreter &interpreter;
   Function<Obj> *declaration;
 };
 
@@ -0,0 +1,110 @@
+#include "Chunk.h"
+
+#include <iomanip>
+#include <iostream>
+
+#include "Interner.h"
+
+using namespace std;
+
+static const char *opNames[] = {
+    "OP_CONSTANT",      "OP_CONSTANT_LONG", "OP_NIL",
+    "OP_TRUE",          "OP_FALSE",         "OP_POP",
+    "OP_GET_LOCAL",     "OP_SET_LOCAL",     "OP_GET_GLOBAL",
+    "OP_DEFINE_GLOBAL", "OP_SET_GLOBAL",    "OP_GET_UPVALUE",
+    "OP_SET_UPVALUE",   "OP_EQUAL",         "OP_NOT_EQUAL",
+    "OP_GREATER",       "OP_GREATER_EQUAL", "OP_LESS",
+    "OP_LESS_EQUAL",    "OP_ADD",           "OP_SUBTRACT",
+    "OP_MULTIPLY",      "OP_DIVIDE",        "OP_NOT",
+    "OP_NEGATE",        "OP_PRINT",         "OP_JUMP",
+    "OP_JUMP_IF_FALSE", "OP_LOOP",          "OP_CALL",
+    "OP_CLOSURE",       "OP_CLOSE_UPVALUE", "OP_RETURN"};
+
+void Chunk::write(uint8_t byte, int line) {
+  code.push_back(byte);
+  lines.push_back(line);
+}
+
+// Equal numbers and interned strings have equal bits and reuse one slot
+int Chunk::addConstant(Obj value) {
+  auto found = constantIndex.find(value.raw());
+  if (found != constantIndex.end())
+    return found->second;
+
+  constants.push_back(value);
+  constantIndex.emplace(value.raw(), constants.size() - 1);
+  return constants.size() - 1;
+}
+
+int Chunk::addFunction(unique_ptr<VmFunction> function) {
+  functions.push_back(std::move(function));
+  return functions.size() - 1;
+}
+
+void Chunk::disassemble(const string &name) {
+  cout << "== " << name << " ==" << endl;
+
+  for (size_t offset = 0; offset < code.size();)
+    offset = disassembleInstruction(offset);
+
+  for (auto &function : functions)
+    function->chunk.disassemble(function->name);
+}
+
+int Chunk::disassembleInstruction(int offset) {
+  uint8_t op = code[offset];
+  cout << setfill('0') << setw(4) << offset << setfill(' ') << " " << setw(4)
+       << lines[offset] << " " << left << setw(18) << opNames[op] << right;
+
+  auto readShort = [&](int at) { return (code[at] << 8) | code[at + 1]; };
+  auto readLong = [&](int at) { return (code[at] << 16) | readShort(at + 1); };
+
+  switch (op) {
+  case OP_CONSTANT: {
+    int index = readShort(offset + 1);
+    cout << index << " '" << to_string(constants[index]) << "'" << endl;
+    return offset + 3;
+  }
+  case OP_CONSTANT_LONG: {
+    int index = readLong(offset + 1);
+    cout << index << " '" << to_string(constants[index]) << "'" << endl;
+    return offset + 4;
+  }
+  case OP_GET_GLOBAL:
+  case OP_DEFINE_GLOBAL:
+  case OP_SET_GLOBAL: {
+    int symbol = readLong(offset + 1);
+    cout << symbol << " '" << interner().name(symbol)->value << "'" << endl;
+    return offset + 4;
+  }
+  case OP_GET_LOCAL:
+  case OP_SET_LOCAL:
+  case OP_GET_UPVALUE:
+  case OP_SET_UPVALUE:
+  case OP_CALL:
+    cout << (int)code[offset + 1] << endl;
+    return offset + 2;
+  case OP_JUMP:
+  case OP_JUMP_IF_FALSE:
+    cout << offset + 3 + readShort(offset + 1) << endl;
+    return offset + 3;
+  case OP_LOOP:
+    cout << offset + 3 - readShort(offset + 1) << endl;
+    return offset + 3;
+  case OP_CLOSURE: {
+    VmFunction *function = functions[readShort(offset + 1)].get();
+    cout << function->name << endl;
+    offset += 3;
+    for (int i = 0; i < function->upvalueCount; i++) {
+      cout << "     |                     "
+           << (code[offset] ? "local " : "upvalue ") << (int)code[offset + 1]
+           << endl;
+      offset += 2;
+    }
+    return offset;
+  }
+  default:
+    cout << endl;
+    return offset + 1;
+  }
+}
@@ -0,0 +1,92 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Util.h"
+
+using namespace std;
+
+enum OpCode : uint8_t {
+  OP_CONSTANT,
+  OP_CONSTANT_LONG,
+  OP_NIL,
+  OP_TRUE,
+  OP_FALSE,
+  OP_POP,
+  OP_GET_LOCAL,
+  OP_SET_LOCAL,
+  OP_GET_GLOBAL,
+  OP_DEFINE_GLOBAL,
+  OP_SET_GLOBAL,
+  OP_GET_UPVALUE,
+  OP_SET_UPVALUE,
+  OP_EQUAL,
+  OP_NOT_EQUAL,
+  OP_GREATER,
+  OP_GREATER_EQUAL,
+  OP_LESS,
+  OP_LESS_EQUAL,
+  OP_ADD,
+  OP_SUBTRACT,
+  OP_MULTIPLY,
+  OP_DIVIDE,
+  OP_NOT,
+  OP_NEGATE,
+  OP_PRINT,
+  OP_JUMP,
+  OP_JUMP_IF_FALSE,
+  OP_LOOP,
+  OP_CALL,
+  OP_CLOSURE,
+  OP_CLOSE_UPVALUE,
+  OP_RETURN
+};
+
+class VmFunction;
+
+// Largest constant index and global symbol, their long operands are three
+// bytes
+#define CHUNK_CONSTANTS_MAX 0xffffff
+#define CHUNK_GLOBALS_MAX 0xffffff
+
+// Bytecode of one function. Operands follow their opcode inline: global
+// symbols take three bytes, constant and function indices and jump offsets
+// two, slots and counts one. Constants past the first 65536 are loaded with
+// OP_CONSTANT_LONG
+class Chunk {
+public:
+  vector<uint8_t> code;
+  vector<int> lines;
+  vector<Obj> constants;
+  // Functions declared in this one, released with it
+  vector<unique_ptr<VmFunction>> functions;
+
+  void write(uint8_t byte, int line);
+  int addConstant(Obj value);
+  int addFunction(unique_ptr<VmFunction> function);
+  void disassemble(const string &name);
+  int disassembleInstruction(int offset);
+
+private:
+  // Index of each constant by its bits, so equal ones share a slot
+  unordered_map<uint64_t, int> constantIndex;
+};
+
+// Compiled function prototype, instantiated at runtime by OP_CLOSURE. Owned
+// by the chunk of the enclosing function, the script by whoever compiled it
+class VmFunction {
+public:
+  int arity;
+  int upvalueCount;
+  Chunk chunk;
+  string name;
+
+  VmFunction(string name) : arity(0), upvalueCount(0), name(name) {}
+};
+
+#endif
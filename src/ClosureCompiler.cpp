@@ -0,0 +1,412 @@
+#include "ClosureCompiler.h"
+
+#include <iostream>
+
+#include "Interner.h"
+
+using namespace std;
+
+// ----------------------------------------
+// Compiled function definitions
+CompiledFunction::CompiledFunction(ClosureCompiler &engine,
+                                   Function<Obj> *declaration,
+                                   shared_ptr<CompiledBlock> body,
+                                   Environment *closure)
+    : closure(closure), engine(engine), declaration(declaration), body(body) {}
+
+int CompiledFunction::arity() { return declaration->params.size(); }
+
+Obj CompiledFunction::call(list<Obj> arguments) {
+  return engine.callFunction(closure, arguments, [&](Environment *env) {
+    return engine.executeBlock(*body, env);
+  });
+}
+
+string CompiledFunction::to_string() {
+  return "<fn " + string(declaration->name.lexeme);
+}
+
+void CompiledFunction::trace(Gc &gc) { gc.markObject(closure); }
+
+// ----------------------------------------
+// Engine definitions
+ClosureCompiler::ClosureCompiler() : scopeDepth(0) {}
+
+void ClosureCompiler::interpret(const vector<Stmt<Obj> *> &stmts) {
+  // Everything is compiled up front, so running starts from a finished tree
+  CompiledBlock script;
+  for (auto stmt : stmts)
+    script.push_back(compile(stmt));
+
+  try {
+    for (auto &stmt : script)
+      stmt();
+  } catch (const RuntimeError &error) {
+    runtimeError(error);
+    temps.clear();
+  }
+}
+
+Obj ClosureCompiler::executeBlock(const CompiledBlock &stmts,
+                                  Environment *env) {
+  return runBlock(stmts.begin(), stmts.end(), env,
+                  [](const CompiledStmt &stmt) { return stmt(); });
+}
+
+CompiledExpr ClosureCompiler::compile(Expr<Obj> *expr) {
+  expr->accept(this);
+  return expression;
+}
+
+CompiledStmt ClosureCompiler::compile(Stmt<Obj> *stmt) {
+  stmt->accept(this);
+  return statement;
+}
+
+shared_ptr<CompiledBlock>
+ClosureCompiler::compile(const list<Stmt<Obj> *> &stmts) {
+  auto block = make_shared<CompiledBlock>();
+  for (auto stmt : stmts)
+    block->push_back(compile(stmt));
+
+  return block;
+}
+
+void ClosureCompiler::checkNumberOperand(const Token &token, Obj operand) {
+  if (operand.isNumber())
+    return;
+  throw RuntimeError(token, "Operand must be a number!");
+}
+
+// ----------------------------------------
+// Expressions
+Obj ClosureCompiler::visitExprAssign(Assign<Obj> *expr) {
+  CompiledExpr value = compile(expr->value);
+  Token name = expr->name;
+  int depth = expr->depth;
+  int slot = expr->slot;
+
+  if (depth < 0)
+    expression = [this, value, name] {
+      Obj result = value();
+      globals->assign(name, result);
+      return result;
+    };
+  else
+    expression = [this, value, depth, slot] {
+      Obj result = value();
+      env->assignAt(depth, slot, result);
+      return result;
+    };
+
+  return monostate();
+}
+
+// Operand checks and the operation itself are fixed when the closure is
+// built, only the operands are evaluated at runtime
+template <typename Op>
+CompiledExpr ClosureCompiler::numberBinary(CompiledExpr left,
+                                           CompiledExpr right, Token op) {
+  return [left, right, op] {
+    Obj a = left();
+    Obj b = right();
+    checkNumberOperand(op, a);
+    checkNumberOperand(op, b);
+    return Obj(Op()(a.asNumber(), b.asNumber()));
+  };
+}
+
+Obj ClosureCompiler::visitExprBinary(Binary<Obj> *expr) {
+  CompiledExpr left = compile(expr->left);
+  CompiledExpr right = compile(expr->right);
+  Token op = expr->op;
+
+  switch (op.type) {
+  case GREATER:
+    expression = numberBinary<greater<double>>(left, right, op);
+    break;
+  case GREATER_EQUAL:
+    expression = numberBinary<greater_equal<double>>(left, right, op);
+    break;
+  case LESS:
+    expression = numberBinary<less<double>>(left, right, op);
+    break;
+  case LESS_EQUAL:
+    expression = numberBinary<less_equal<double>>(left, right, op);
+    break;
+  case MINUS:
+    expression = numberBinary<minus<double>>(left, right, op);
+    break;
+  case SLASH:
+    expression = numberBinary<divides<double>>(left, right, op);
+    break;
+  case STAR:
+    expression = numberBinary<multiplies<double>>(left, right, op);
+    break;
+  case EQUAL_EQUAL:
+  case BANG_EQUAL: {
+    bool equal = op.type == EQUAL_EQUAL;
+    expression = [this, left, right, equal] {
+      Obj a = left();
+      temps.push_back(a);
+      Obj b = right();
+      temps.pop_back();
+      return Obj((a == b) == equal);
+    };
+    break;
+  }
+  case PLUS:
+    // The left operand must stay visible to the collector while the right
+    // side runs
+    expression = [this, left, right, op] {
+      Obj a = left();
+      temps.push_back(a);
+      Obj b = right();
+      temps.pop_back();
+
+      if (a.isNumber() && b.isNumber())
+        return Obj(a.asNumber() + b.asNumber());
+      if (a.isString() && b.isString())
+        return Obj(newString(a.asString()->value + b.asString()->value));
+
+      throw RuntimeError(op, "Operands must be two numbers or strings");
+    };
+    break;
+  default:
+    // Like the Interpreter, both sides run and the result is nil
+    expression = [left, right] {
+      left();
+      right();
+      return Obj();
+    };
+    break;
+  }
+
+  return monostate();
+}
+
+Obj ClosureCompiler::visitExprCall(Call<Obj> *expr) {
+  CompiledExpr callee = compile(expr->callee);
+  vector<CompiledExpr> arguments;
+  for (auto arg : expr->arguments)
+    arguments.push_back(compile(arg));
+  Token paren = expr->paren;
+
+  expression = [this, callee, arguments, paren] {
+    // Callee and arguments stay rooted until the call binds them
+    size_t base = temps.size();
+    Obj function = callee();
+    temps.push_back(function);
+
+    list<Obj> values;
+    for (auto &arg : arguments) {
+      values.push_back(arg());
+      temps.push_back(values.back());
+    }
+
+    if (!function.isCallable())
+      throw RuntimeError(paren, "Can only call functions and classes.");
+
+    Callable *callable = function.asCallable();
+    if ((int)values.size() != callable->arity())
+      throw RuntimeError(paren,
+                         string("Expected ") + to_string(callable->arity()) +
+                             string(" arguments but got ") +
+                             to_string(values.size()) + string("."));
+
+    Obj result = callable->call(values);
+    temps.resize(base);
+    return result;
+  };
+
+  return monostate();
+}
+
+Obj ClosureCompiler::visitExprGrouping(Grouping<Obj> *expr) {
+  expression = compile(expr->grouping);
+  return monostate();
+}
+
+Obj ClosureCompiler::visitExprLiteral(Literal<Obj> *expr) {
+  Obj value = expr->value;
+  expression = [value] { return value; };
+  return monostate();
+}
+
+Obj ClosureCompiler::visitExprLogical(Logical<Obj> *expr) {
+  CompiledExpr left = compile(expr->left);
+  CompiledExpr right = compile(expr->right);
+
+  if (expr->op.type == OR)
+    expression = [left, right] {
+      Obj value = left();
+      return isTrue(value) ? value : right();
+    };
+  else
+    expression = [left, right] {
+      Obj value = left();
+      return isTrue(value) ? right() : value;
+    };
+
+  return monostate();
+}
+
+Obj ClosureCompiler::visitExprUnary(Unary<Obj> *expr) {
+  CompiledExpr right = compile(expr->right);
+  Token op = expr->op;
+
+  switch (op.type) {
+  case MINUS:
+    expression = [right, op] {
+      Obj value = right();
+      checkNumberOperand(op, value);
+      return Obj(-value.asNumber());
+    };
+    break;
+  case BANG:
+    expression = [right] { return Obj(!isTrue(right())); };
+    break;
+  default:
+    expression = [right] {
+      right();
+      return Obj();
+    };
+    break;
+  }
+
+  return monostate();
+}
+
+Obj ClosureCompiler::visitExprVariable(Variable<Obj> *expr) {
+  Token name = expr->name;
+  int depth = expr->depth;
+  int slot = expr->slot;
+
+  // The common cases skip walking the scope chain
+  if (depth < 0)
+    expression = [this, name] { return globals->get(name); };
+  else if (depth == 0)
+    expression = [this, slot] { return env->getAt(0, slot); };
+  else
+    expression = [this, depth, slot] { return env->getAt(depth, slot); };
+
+  return monostate();
+}
+
+// ----------------------------------------
+// Statements
+Obj ClosureCompiler::visitStmtBlock(Block<Obj> *stmt) {
+  scopeDepth++;
+  auto body = compile(stmt->statements);
+  scopeDepth--;
+
+  statement = [this, body] {
+    return executeBlock(*body, newEnvironment(env));
+  };
+  return monostate();
+}
+
+Obj ClosureCompiler::visitStmtExpression(Expression<Obj> *stmt) {
+  CompiledExpr expr = compile(stmt->expr);
+  statement = [expr] {
+    expr();
+    return Obj();
+  };
+  return monostate();
+}
+
+Obj ClosureCompiler::visitStmtFunction(Function<Obj> *stmt) {
+  scopeDepth++;
+  auto body = compile(stmt->body);
+  scopeDepth--;
+
+  bool global = scopeDepth == 0;
+  int symbol = stmt->name.symbol;
+  statement = [this, stmt, body, global, symbol] {
+    auto function = gc().allocate<CompiledFunction>(*this, stmt, body, env);
+    env->capture();
+    if (global)
+      globals->define(symbol, function);
+    else
+      env->define(function);
+    return Obj();
+  };
+  return monostate();
+}
+
+Obj ClosureCompiler::visitStmtIf(If<Obj> *stmt) {
+  CompiledExpr condition = compile(stmt->condition);
+  CompiledStmt thenBranch = compile(stmt->thenBranch);
+
+  if (stmt->elseBranch) {
+    CompiledStmt elseBranch = compile(stmt->elseBranch);
+    statement = [condition, thenBranch, elseBranch] {
+      return isTrue(condition()) ? thenBranch() : elseBranch();
+    };
+  } else {
+    statement = [condition, thenBranch] {
+      return isTrue(condition()) ? thenBranch() : Obj();
+    };
+  }
+
+  return monostate();
+}
+
+Obj ClosureCompiler::visitStmtPrint(Print<Obj> *stmt) {
+  CompiledExpr expr = compile(stmt->expr);
+  statement = [expr] {
+    cout << to_string(expr()) << endl;
+    return Obj();
+  };
+  return monostate();
+}
+
+Obj ClosureCompiler::visitStmtReturn(Return<Obj> *stmt) {
+  CompiledExpr value =
+      stmt->value ? compile(stmt->value) : [] { return Obj(); };
+
+  statement = [this, value] {
+    Obj result = value();
+    completion = COMPLETION_RETURN;
+    return result;
+  };
+  return monostate();
+}
+
+Obj ClosureCompiler::visitStmtVar(Var<Obj> *stmt) {
+  CompiledExpr initializer =
+      stmt->initializer ? compile(stmt->initializer) : [] { return Obj(); };
+
+  // Top level declarations are globals, everything else takes the next slot
+  if (scopeDepth == 0) {
+    int symbol = stmt->name.symbol;
+    statement = [this, initializer, symbol] {
+      globals->define(symbol, initializer());
+      return Obj();
+    };
+  } else {
+    statement = [this, initializer] {
+      Obj value = initializer();
+      env->define(value);
+      return Obj();
+    };
+  }
+
+  return monostate();
+}
+
+Obj ClosureCompiler::visitStmtWhile(While<Obj> *stmt) {
+  CompiledExpr condition = compile(stmt->condition);
+  CompiledStmt body = compile(stmt->body);
+
+  statement = [this, condition, body] {
+    while (isTrue(condition())) {
+      Obj value = body();
+      if (completion == COMPLETION_RETURN)
+        return value;
+    }
+
+    return Obj();
+  };
+  return monostate();
+}
@@ -0,0 +1,86 @@
+#ifndef CLOSURE_COMPILER_H
+#define CLOSURE_COMPILER_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Callable.h"
+#include "Environment.h"
+#include "Gc.h"
+#include "Interpreter.h"
+#include "ScopedEngine.h"
+#include "Util.h"
+#include "gen/Expr.hpp"
+#include "gen/Stmt.hpp"
+
+using namespace std;
+
+// Expressions and statements turned into C++ closures. Statements return the
+// value of a return statement, like Interpreter::execute
+typedef function<Obj()> CompiledExpr;
+typedef function<Obj()> CompiledStmt;
+typedef vector<CompiledStmt> CompiledBlock;
+
+class ClosureCompiler;
+
+class CompiledFunction : public Callable {
+public:
+  Environment *closure;
+  CompiledFunction(ClosureCompiler &engine, Function<Obj> *declaration,
+                   shared_ptr<CompiledBlock> body, Environment *closure);
+  int arity() override;
+  Obj call(list<Obj> arguments) override;
+  string to_string() override;
+  void trace(Gc &gc) override;
+
+private:
+  ClosureCompiler &engine;
+  Function<Obj> *declaration;
+  shared_ptr<CompiledBlock> body;
+};
+
+// Engine selected with --engine=closure. The resolved AST is walked once and
+// every node becomes a closure with its operands and operator already bound,
+// running the script is then just calling them, with no visitor dispatch or
+// operator switch left. Scopes work like in the Interpreter
+class ClosureCompiler : ExprAstVisitor<Obj>,
+                        StmtAstVisitor<Obj>,
+                        public ScopedEngine {
+public:
+  ClosureCompiler();
+  void interpret(const vector<Stmt<Obj> *> &stmts);
+  Obj executeBlock(const CompiledBlock &stmts, Environment *env);
+  Obj visitExprAssign(Assign<Obj> *expr) override;
+  Obj visitExprBinary(Binary<Obj> *expr) override;
+  Obj visitExprCall(Call<Obj> *expr) override;
+  Obj visitExprGrouping(Grouping<Obj> *expr) override;
+  Obj visitExprLiteral(Literal<Obj> *expr) override;
+  Obj visitExprLogical(Logical<Obj> *expr) override;
+  Obj visitExprUnary(Unary<Obj> *expr) override;
+  Obj visitExprVariable(Variable<Obj> *expr) override;
+  Obj visitStmtBlock(Block<Obj> *stmt) override;
+  Obj visitStmtExpression(Expression<Obj> *stmt) override;
+  Obj visitStmtFunction(Function<Obj> *stmt) override;
+  Obj visitStmtIf(If<Obj> *stmt) override;
+  Obj visitStmtPrint(Print<Obj> *stmt) override;
+  Obj visitStmtReturn(Return<Obj> *stmt) override;
+  Obj visitStmtVar(Var<Obj> *stmt) override;
+  Obj visitStmtWhile(While<Obj> *stmt) override;
+
+private:
+  // Compilation state. The closure built by the last visit, and how many
+  // scopes deep it sits, 0 being globals
+  CompiledExpr expression;
+  CompiledStmt statement;
+  int scopeDepth;
+
+  CompiledExpr compile(Expr<Obj> *expr);
+  CompiledStmt compile(Stmt<Obj> *stmt);
+  shared_ptr<CompiledBlock> compile(const list<Stmt<Obj> *> &stmts);
+  template <typename Op>
+  CompiledExpr numberBinary(CompiledExpr left, CompiledExpr right, Token op);
+  static void checkNumberOperand(const Token &token, Obj operand);
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef COMPILATION_UNIT_H
+#define COMPILATION_UNIT_H
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "Arena.h"
+#include "Lex.h"
+#include "Source.h"
+#include "gen/Stmt.hpp"
+
+using namespace std;
+
+// Everything produced from one piece of source: the text, its tokens and the
+// AST allocated in the arena. All of it is released at once when the unit is
+// destroyed, so the unit must outlive whatever engine runs its statements
+class CompilationUnit {
+public:
+  Source source;
+  // The source's text, which tokens and the AST point into
+  string_view src;
+  vector<Token> tokens;
+  vector<Stmt<Obj> *> statements;
+  Arena arena;
+  // Extra arenas of the threads that parsed parts of the unit concurrently
+  list<Arena> chunkArenas;
+
+  CompilationUnit(Source source)
+      : source(std::move(source)), src(this->source.text()) {}
+};
+
+#endif
@@ -0,0 +1,477 @@
+#include "Compiler.h"
+
+#include "Lex.h"
+
+using namespace std;
+
+Compiler::Compiler() : err(false), current(nullptr), line(0) {}
+
+unique_ptr<VmFunction> Compiler::compile(vector<Stmt<Obj> *> stmts) {
+  auto function = make_unique<VmFunction>("script");
+  FunctionState script{nullptr, function.get(), {}, {}, 0};
+
+  // Slot zero of every frame holds the closure being run
+  script.locals.push_back({"", 0, false});
+  current = &script;
+
+  for (auto stmt : stmts)
+    compile(stmt);
+
+  emit(OP_NIL);
+  emit(OP_RETURN);
+
+  current = nullptr;
+  return function;
+}
+
+// ----------------------------------------
+// Emit helpers
+Chunk &Compiler::chunk() { return current->function->chunk; }
+
+void Compiler::compile(const list<Stmt<Obj> *> &stmts) {
+  for (auto stmt : stmts)
+    compile(stmt);
+}
+
+void Compiler::compile(Stmt<Obj> *stmt) { stmt->accept(this); }
+
+void Compiler::compile(Expr<Obj> *expr) { expr->accept(this); }
+
+void Compiler::emit(uint8_t byte) { chunk().write(byte, line); }
+
+void Compiler::emit(uint8_t byte1, uint8_t byte2) {
+  emit(byte1);
+  emit(byte2);
+}
+
+void Compiler::emitShort(int value) {
+  emit((value >> 8) & 0xff);
+  emit(value & 0xff);
+}
+
+// Three byte operand, high byte first
+void Compiler::emitLong(int value) {
+  emit((value >> 16) & 0xff);
+  emitShort(value & 0xffff);
+}
+
+void Compiler::emitConstant(Obj value) {
+  int constant = makeConstant(value);
+  if (constant <= UINT16_MAX) {
+    emit(OP_CONSTANT);
+    emitShort(constant);
+  } else {
+    emit(OP_CONSTANT_LONG);
+    emitLong(constant);
+  }
+}
+
+int Compiler::emitJump(uint8_t op) {
+  emit(op);
+  emitShort(0xffff);
+  return chunk().code.size() - 2;
+}
+
+void Compiler::patchJump(int offset) {
+  // -2 to skip the jump operand itself
+  int jump = chunk().code.size() - offset - 2;
+  if (jump > UINT16_MAX)
+    error("Too much code to jump over.");
+
+  chunk().code[offset] = (jump >> 8) & 0xff;
+  chunk().code[offset + 1] = jump & 0xff;
+}
+
+void Compiler::emitLoop(int loopStart) {
+  emit(OP_LOOP);
+
+  int offset = chunk().code.size() - loopStart + 2;
+  if (offset > UINT16_MAX)
+    error("Loop body too large.");
+
+  emitShort(offset);
+}
+
+int Compiler::makeConstant(Obj value) {
+  int constant = chunk().addConstant(value);
+  if (constant > CHUNK_CONSTANTS_MAX) {
+    // Reported for the first constant past the limit only
+    if (constant == CHUNK_CONSTANTS_MAX + 1)
+      error("Too many constants in one chunk.");
+    return 0;
+  }
+
+  return constant;
+}
+
+// Globals are addressed by symbol id, so names never use up constants. Ids
+// are handed out to every name in the program, so they take three bytes
+int Compiler::globalSymbol(Token name) {
+  if (name.symbol > CHUNK_GLOBALS_MAX) {
+    error("Too many global names.");
+    return 0;
+  }
+
+  return name.symbol;
+}
+
+void Compiler::error(string message) {
+  err = true;
+  report(line, "", message);
+}
+
+// ----------------------------------------
+// Scopes and variables
+void Compiler::beginScope() { current->scopeDepth++; }
+
+void Compiler::endScope() {
+  current->scopeDepth--;
+
+  auto &locals = current->locals;
+  while (!locals.empty() && locals.back().depth > current->scopeDepth) {
+    if (locals.back().isCaptured)
+      emit(OP_CLOSE_UPVALUE);
+    else
+      emit(OP_POP);
+    locals.pop_back();
+  }
+}
+
+void Compiler::addLocal(Token name) {
+  if (current->locals.size() > UINT8_MAX) {
+    error("Too many local variables in function.");
+    return;
+  }
+
+  // Depth -1 marks the local as declared but not initialized yet
+  current->locals.push_back({name.lexeme, -1, false});
+}
+
+void Compiler::markInitialized() {
+  if (current->scopeDepth == 0)
+    return;
+
+  current->locals.back().depth = current->scopeDepth;
+}
+
+void Compiler::declareVariable(Token name) {
+  if (current->scopeDepth == 0)
+    return;
+
+  addLocal(name);
+}
+
+void Compiler::defineVariable(Token name) {
+  if (current->scopeDepth > 0) {
+    markInitialized();
+    return;
+  }
+
+  emit(OP_DEFINE_GLOBAL);
+  emitLong(globalSymbol(name));
+}
+
+int Compiler::resolveLocal(FunctionState *state, Token name) {
+  for (int i = state->locals.size() - 1; i >= 0; i--) {
+    if (state->locals[i].name == name.lexeme)
+      return i;
+  }
+
+  return -1;
+}
+
+int Compiler::resolveUpvalue(FunctionState *state, Token name) {
+  if (state->enclosing == nullptr)
+    return -1;
+
+  int local = resolveLocal(state->enclosing, name);
+  if (local != -1) {
+    state->enclosing->locals[local].isCaptured = true;
+    return addUpvalue(state, local, true);
+  }
+
+  int upvalue = resolveUpvalue(state->enclosing, name);
+  if (upvalue != -1)
+    return addUpvalue(state, upvalue, false);
+
+  return -1;
+}
+
+int Compiler::addUpvalue(FunctionState *state, uint8_t index, bool isLocal) {
+  auto &upvalues = state->upvalues;
+  for (size_t i = 0; i < upvalues.size(); i++) {
+    if (upvalues[i].index == index && upvalues[i].isLocal == isLocal)
+      return i;
+  }
+
+  if (upvalues.size() > UINT8_MAX) {
+    error("Too many closure variables in function.");
+    return 0;
+  }
+
+  upvalues.push_back({index, isLocal});
+  return upvalues.size() - 1;
+}
+
+void Compiler::namedVariable(Token name, bool assign) {
+  line = name.line;
+
+  int arg = resolveLocal(current, name);
+  if (arg != -1) {
+    emit(assign ? OP_SET_LOCAL : OP_GET_LOCAL, arg);
+    return;
+  }
+
+  arg = resolveUpvalue(current, name);
+  if (arg != -1) {
+    emit(assign ? OP_SET_UPVALUE : OP_GET_UPVALUE, arg);
+    return;
+  }
+
+  emit(assign ? OP_SET_GLOBAL : OP_GET_GLOBAL);
+  emitLong(globalSymbol(name));
+}
+
+// ----------------------------------------
+// Expressions
+Obj Compiler::visitExprAssign(Assign<Obj> *expr) {
+  compile(expr->value);
+  namedVariable(expr->name, true);
+  return monostate();
+}
+
+Obj Compiler::visitExprBinary(Binary<Obj> *expr) {
+  compile(expr->left);
+  compile(expr->right);
+
+  line = expr->op.line;
+  switch (expr->op.type) {
+  case GREATER:
+    emit(OP_GREATER);
+    break;
+  case GREATER_EQUAL:
+    emit(OP_GREATER_EQUAL);
+    break;
+  case LESS:
+    emit(OP_LESS);
+    break;
+  case LESS_EQUAL:
+    emit(OP_LESS_EQUAL);
+    break;
+  case EQUAL_EQUAL:
+    emit(OP_EQUAL);
+    break;
+  case BANG_EQUAL:
+    emit(OP_NOT_EQUAL);
+    break;
+  case PLUS:
+    emit(OP_ADD);
+    break;
+  case MINUS:
+    emit(OP_SUBTRACT);
+    break;
+  case SLASH:
+    emit(OP_DIVIDE);
+    break;
+  case STAR:
+    emit(OP_MULTIPLY);
+    break;
+  default:
+    // Operators the Interpreter evaluates to nil
+    emit(OP_POP);
+    emit(OP_POP);
+    emit(OP_NIL);
+    break;
+  }
+
+  return monostate();
+}
+
+Obj Compiler::visitExprCall(Call<Obj> *expr) {
+  compile(expr->callee);
+
+  for (auto arg : expr->arguments)
+    compile(arg);
+
+  line = expr->paren.line;
+  emit(OP_CALL, expr->arguments.size());
+  return monostate();
+}
+
+Obj Compiler::visitExprGrouping(Grouping<Obj> *expr) {
+  compile(expr->grouping);
+  return monostate();
+}
+
+Obj Compiler::visitExprLiteral(Literal<Obj> *expr) {
+  if (expr->value.isNil())
+    emit(OP_NIL);
+  else if (expr->value.isBool())
+    emit(expr->value.asBool() ? OP_TRUE : OP_FALSE);
+  else
+    emitConstant(expr->value);
+
+  return monostate();
+}
+
+Obj Compiler::visitExprLogical(Logical<Obj> *expr) {
+  compile(expr->left);
+
+  line = expr->op.line;
+  if (expr->op.type == OR) {
+    int elseJump = emitJump(OP_JUMP_IF_FALSE);
+    int endJump = emitJump(OP_JUMP);
+
+    patchJump(elseJump);
+    emit(OP_POP);
+    compile(expr->right);
+    patchJump(endJump);
+  } else {
+    int endJump = emitJump(OP_JUMP_IF_FALSE);
+
+    emit(OP_POP);
+    compile(expr->right);
+    patchJump(endJump);
+  }
+
+  return monostate();
+}
+
+Obj Compiler::visitExprUnary(Unary<Obj> *expr) {
+  compile(expr->right);
+
+  line = expr->op.line;
+  switch (expr->op.type) {
+  case MINUS:
+    emit(OP_NEGATE);
+    break;
+  case BANG:
+    emit(OP_NOT);
+    break;
+  default:
+    emit(OP_POP);
+    emit(OP_NIL);
+    break;
+  }
+
+  return monostate();
+}
+
+Obj Compiler::visitExprVariable(Variable<Obj> *expr) {
+  namedVariable(expr->name, false);
+  return monostate();
+}
+
+// ----------------------------------------
+// Statements
+Obj Compiler::visitStmtBlock(Block<Obj> *stmt) {
+  beginScope();
+  compile(stmt->statements);
+  endScope();
+  return monostate();
+}
+
+Obj Compiler::visitStmtExpression(Expression<Obj> *stmt) {
+  compile(stmt->expr);
+  emit(OP_POP);
+  return monostate();
+}
+
+Obj Compiler::visitStmtFunction(Function<Obj> *stmt) {
+  line = stmt->name.line;
+  declareVariable(stmt->name);
+
+  // The function may refer to itself, so its name is usable right away
+  markInitialized();
+
+  auto function = make_unique<VmFunction>(string(stmt->name.lexeme));
+  FunctionState state{current, function.get(), {}, {}, 0};
+  state.function->arity = stmt->params.size();
+  state.locals.push_back({"", 0, false});
+  current = &state;
+
+  // Parameters and body share one scope, which dies with the frame
+  beginScope();
+  for (auto &param : stmt->params) {
+    declareVariable(param);
+    markInitialized();
+  }
+  compile(stmt->body);
+  emit(OP_NIL);
+  emit(OP_RETURN);
+
+  current = state.enclosing;
+  state.function->upvalueCount = state.upvalues.size();
+
+  line = stmt->name.line;
+  emit(OP_CLOSURE);
+  emitShort(chunk().addFunction(std::move(function)));
+  for (auto &upvalue : state.upvalues)
+    emit(upvalue.isLocal ? 1 : 0, upvalue.index);
+
+  defineVariable(stmt->name);
+  return monostate();
+}
+
+Obj Compiler::visitStmtIf(If<Obj> *stmt) {
+  compile(stmt->condition);
+
+  int thenJump = emitJump(OP_JUMP_IF_FALSE);
+  emit(OP_POP);
+  compile(stmt->thenBranch);
+
+  int elseJump = emitJump(OP_JUMP);
+  patchJump(thenJump);
+  emit(OP_POP);
+
+  if (stmt->elseBranch)
+    compile(stmt->elseBranch);
+  patchJump(elseJump);
+
+  return monostate();
+}
+
+Obj Compiler::visitStmtPrint(Print<Obj> *stmt) {
+  compile(stmt->expr);
+  emit(OP_PRINT);
+  return monostate();
+}
+
+Obj Compiler::visitStmtReturn(Return<Obj> *stmt) {
+  if (stmt->value)
+    compile(stmt->value);
+  else
+    emit(OP_NIL);
+
+  line = stmt->keyword.line;
+  emit(OP_RETURN);
+  return monostate();
+}
+
+Obj Compiler::visitStmtVar(Var<Obj> *stmt) {
+  line = stmt->name.line;
+  declareVariable(stmt->name);
+
+  if (stmt->initializer != nullptr)
+    compile(stmt->initializer);
+  else
+    emit(OP_NIL);
+
+  line = stmt->name.line;
+  defineVariable(stmt->name);
+  return monostate();
+}
+
+Obj Compiler::visitStmtWhile(While<Obj> *stmt) {
+  int loopStart = chunk().code.size();
+  compile(stmt->condition);
+
+  int exitJump = emitJump(OP_JUMP_IF_FALSE);
+  emit(OP_POP);
+  compile(stmt->body);
+  emitLoop(loopStart);
+
+  patchJump(exitJump);
+  emit(OP_POP);
+  return monostate();
+}
@@ -0,0 +1,91 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Chunk.h"
+#include "Util.h"
+#include "gen/Expr.hpp"
+#include "gen/Stmt.hpp"
+
+using namespace std;
+
+// Compiles the resolved AST into bytecode for the VM. Locals live in stack
+// slots and are captured through upvalues, so the compiler keeps its own
+// scope bookkeeping instead of using the Resolver's environment slots
+class Compiler : ExprAstVisitor<Obj>, StmtAstVisitor<Obj> {
+public:
+  bool err;
+  Compiler();
+  unique_ptr<VmFunction> compile(vector<Stmt<Obj> *> stmts);
+  Obj visitExprAssign(Assign<Obj> *expr) override;
+  Obj visitExprBinary(Binary<Obj> *expr) override;
+  Obj visitExprCall(Call<Obj> *expr) override;
+  Obj visitExprGrouping(Grouping<Obj> *expr) override;
+  Obj visitExprLiteral(Literal<Obj> *expr) override;
+  Obj visitExprLogical(Logical<Obj> *expr) override;
+  Obj visitExprUnary(Unary<Obj> *expr) override;
+  Obj visitExprVariable(Variable<Obj> *expr) override;
+  Obj visitStmtBlock(Block<Obj> *stmt) override;
+  Obj visitStmtExpression(Expression<Obj> *stmt) override;
+  Obj visitStmtFunction(Function<Obj> *stmt) override;
+  Obj visitStmtIf(If<Obj> *stmt) override;
+  Obj visitStmtPrint(Print<Obj> *stmt) override;
+  Obj visitStmtReturn(Return<Obj> *stmt) override;
+  Obj visitStmtVar(Var<Obj> *stmt) override;
+  Obj visitStmtWhile(While<Obj> *stmt) override;
+
+private:
+  struct Local {
+    string_view name;
+    int depth;
+    bool isCaptured;
+  };
+
+  struct Upvalue {
+    uint8_t index;
+    bool isLocal;
+  };
+
+  struct FunctionState {
+    FunctionState *enclosing;
+    VmFunction *function;
+    vector<Local> locals;
+    vector<Upvalue> upvalues;
+    int scopeDepth;
+  };
+
+  FunctionState *current;
+  int line;
+
+  Chunk &chunk();
+  void compile(const list<Stmt<Obj> *> &stmts);
+  void compile(Stmt<Obj> *stmt);
+  void compile(Expr<Obj> *expr);
+  void emit(uint8_t byte);
+  void emit(uint8_t byte1, uint8_t byte2);
+  void emitShort(int value);
+  void emitLong(int value);
+  void emitConstant(Obj value);
+  int emitJump(uint8_t op);
+  void patchJump(int offset);
+  void emitLoop(int loopStart);
+  int makeConstant(Obj value);
+  int globalSymbol(Token name);
+  void beginScope();
+  void endScope();
+  void addLocal(Token name);
+  void markInitialized();
+  void declareVariable(Token name);
+  void defineVariable(Token name);
+  int resolveLocal(FunctionState *state, Token name);
+  int resolveUpvalue(FunctionState *state, Token name);
+  int addUpvalue(FunctionState *state, uint8_t index, bool isLocal);
+  void namedVariable(Token name, bool assign);
+  void error(string message);
+};
+
+#endif
@@ -0,0 +1,376 @@
+#include "CppEmitter.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+CppEmitter::CppEmitter() : functionDepth(0), localCount(0), indent(0) {}
+
+string CppEmitter::emit(const vector<Stmt<Obj> *> &stmts) {
+  // Whether a local lives on the heap is only known once every nested
+  // function was seen, so the first pass just collects the captured ones
+  for (int pass = 0; pass < 2; pass++) {
+    out.str("");
+    scopes.clear();
+    scopeFunctions.clear();
+    functionDepth = 0;
+    localCount = 0;
+    indent = 1;
+
+    for (auto stmt : stmts)
+      statement(stmt);
+  }
+
+  ostringstream unit;
+  unit << "// Generated by cpplox --emit-cpp, build with\n"
+       << "//   clang++ -std=c++17 -O2 -I <cpplox>/src/runtime <this file>\n"
+       << "#include \"LoxRuntime.h\"\n\n";
+
+  for (auto &constant : strings)
+    unit << "static const LoxValue s_" << constant.second << " = loxString("
+         << quote(constant.first) << ");\n";
+
+  // clock is the only global defined before the script runs
+  unit << "static LoxValue g_clock = loxClock();\n";
+  for (auto &name : globals)
+    if (name != "clock")
+      unit << "static LoxValue g_" << name << " = loxUndefined();\n";
+
+  unit << "\nstatic void script() {\n"
+       << out.str() << "}\n\n"
+       << "int main() { return loxMain(script); }\n";
+  return unit.str();
+}
+
+string CppEmitter::expression(Expr<Obj> *expr) {
+  expr->accept(this);
+  return code;
+}
+
+void CppEmitter::statement(Stmt<Obj> *stmt) { stmt->accept(this); }
+
+void CppEmitter::statements(const list<Stmt<Obj> *> &stmts) {
+  for (auto stmt : stmts)
+    statement(stmt);
+}
+
+void CppEmitter::line(const string &text) {
+  out << string(indent * 2, ' ') << text << "\n";
+}
+
+void CppEmitter::beginScope() {
+  scopes.push_back({});
+  scopeFunctions.push_back(functionDepth);
+}
+
+void CppEmitter::endScope() {
+  scopes.pop_back();
+  scopeFunctions.pop_back();
+}
+
+// Emits the declaration of a local initialized to value and returns how to
+// refer to it. Top level names are globals, declared by emit
+string CppEmitter::declare(const Token &name, const string &value) {
+  if (scopes.empty()) {
+    string variable = global(name);
+    line(variable + " = " + value + ";");
+    return variable;
+  }
+
+  Local local = {&name, "l_" + string(name.lexeme) + "_" +
+                            to_string(localCount++)};
+  scopes.back().push_back(local);
+
+  if (captured.count(&name))
+    line("LoxCell " + local.name + " = loxCell(" + value + ");");
+  else
+    line("LoxValue " + local.name + " = " + value + ";");
+
+  return reference(local);
+}
+
+string CppEmitter::reference(const Local &local) {
+  return captured.count(local.declaration) ? "(*" + local.name + ")"
+                                           : local.name;
+}
+
+// The static holding a global, which emit declares once it is used
+string CppEmitter::global(const Token &name) {
+  string text(name.lexeme);
+  globals.insert(text);
+  return "g_" + text;
+}
+
+// Resolved the same way as Environment::getAt, a local of an enclosing
+// function is a captured one
+string CppEmitter::variable(int depth, int slot) {
+  int scope = scopes.size() - 1 - depth;
+  Local &local = scopes[scope][slot];
+  if (scopeFunctions[scope] < functionDepth)
+    captured.insert(local.declaration);
+
+  return reference(local);
+}
+
+// Printed back exactly, numbers that have no literal go through their bits
+string CppEmitter::number(double value) {
+  char text[64];
+  if (!isfinite(value)) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(double));
+    snprintf(text, sizeof(text), "loxBits(0x%llxULL)",
+             (unsigned long long)bits);
+    return text;
+  }
+
+  snprintf(text, sizeof(text), "%.17g", value);
+  string literal = text;
+  if (literal.find_first_of(".e") == string::npos)
+    literal += ".0";
+  return literal;
+}
+
+string CppEmitter::quote(const string &text) {
+  string quoted = "\"";
+  for (unsigned char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (c < 0x20 || c >= 0x7f) {
+      // Always three octal digits, so a following digit can't join in
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\%03o", c);
+      quoted += escape;
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+// ----------------------------------------
+// Expressions
+Obj CppEmitter::visitExprAssign(Assign<Obj> *expr) {
+  string value = expression(expr->value);
+  string where = to_string(expr->name.line);
+
+  if (expr->depth < 0) {
+    string name(expr->name.lexeme);
+    code = "loxAssignGlobal(" + global(expr->name) + ", " + value + ", \"" +
+           name + "\", " + where + ")";
+  } else {
+    code = "(" + variable(expr->depth, expr->slot) + " = " + value + ")";
+  }
+
+  return monostate();
+}
+
+Obj CppEmitter::visitExprBinary(Binary<Obj> *expr) {
+  string operands =
+      "{" + expression(expr->left) + ", " + expression(expr->right) + "}";
+  string where = to_string(expr->op.line);
+
+  switch (expr->op.type) {
+  case PLUS:
+    code = "loxAdd(" + operands + ", " + where + ")";
+    break;
+  case MINUS:
+    code = "loxSubtract(" + operands + ", " + where + ")";
+    break;
+  case STAR:
+    code = "loxMultiply(" + operands + ", " + where + ")";
+    break;
+  case SLASH:
+    code = "loxDivide(" + operands + ", " + where + ")";
+    break;
+  case GREATER:
+    code = "loxGreater(" + operands + ", " + where + ")";
+    break;
+  case GREATER_EQUAL:
+    code = "loxGreaterEqual(" + operands + ", " + where + ")";
+    break;
+  case LESS:
+    code = "loxLess(" + operands + ", " + where + ")";
+    break;
+  case LESS_EQUAL:
+    code = "loxLessEqual(" + operands + ", " + where + ")";
+    break;
+  case EQUAL_EQUAL:
+    code = "LoxValue(loxEqual(" + operands + "))";
+    break;
+  case BANG_EQUAL:
+    code = "LoxValue(!loxEqual(" + operands + "))";
+    break;
+  default:
+    code = "loxNil(" + operands + ")";
+    break;
+  }
+
+  return monostate();
+}
+
+Obj CppEmitter::visitExprCall(Call<Obj> *expr) {
+  string values = expression(expr->callee);
+  for (auto arg : expr->arguments)
+    values += ", " + expression(arg);
+
+  code = "loxCall({" + values + "}, " + to_string(expr->paren.line) + ")";
+  return monostate();
+}
+
+Obj CppEmitter::visitExprGrouping(Grouping<Obj> *expr) {
+  code = expression(expr->grouping);
+  return monostate();
+}
+
+Obj CppEmitter::visitExprLiteral(Literal<Obj> *expr) {
+  Obj value = expr->value;
+
+  if (value.isNumber()) {
+    code = "LoxValue(" + number(value.asNumber()) + ")";
+  } else if (value.isBool()) {
+    code = value.asBool() ? "LoxValue(true)" : "LoxValue(false)";
+  } else if (value.isString()) {
+    string text = value.asString()->value;
+    auto constant = strings.find(text);
+    if (constant == strings.end())
+      constant = strings.insert({text, (int)strings.size()}).first;
+    code = "s_" + to_string(constant->second);
+  } else {
+    code = "LoxValue()";
+  }
+
+  return monostate();
+}
+
+// Lox yields the deciding operand itself, not a bool, so the left one is
+// kept in a temporary
+Obj CppEmitter::visitExprLogical(Logical<Obj> *expr) {
+  string left = expression(expr->left);
+  string right = expression(expr->right);
+  string test = expr->op.type == OR ? "loxTruthy(left)" : "!loxTruthy(left)";
+
+  code = "[&]() -> LoxValue { LoxValue left = " + left + "; return " + test +
+         " ? left : " + right + "; }()";
+  return monostate();
+}
+
+Obj CppEmitter::visitExprUnary(Unary<Obj> *expr) {
+  string right = expression(expr->right);
+
+  if (expr->op.type == MINUS)
+    code = "loxNegate(" + right + ", " + to_string(expr->op.line) + ")";
+  else
+    code = "LoxValue(!loxTruthy(" + right + "))";
+
+  return monostate();
+}
+
+Obj CppEmitter::visitExprVariable(Variable<Obj> *expr) {
+  if (expr->depth < 0) {
+    string name(expr->name.lexeme);
+    code = "loxGlobal(" + global(expr->name) + ", \"" + name + "\", " +
+           to_string(expr->name.line) + ")";
+  } else {
+    code = variable(expr->depth, expr->slot);
+  }
+
+  return monostate();
+}
+
+// ----------------------------------------
+// Statements
+Obj CppEmitter::visitStmtBlock(Block<Obj> *stmt) {
+  line("{");
+  indent++;
+  beginScope();
+  statements(stmt->statements);
+  endScope();
+  indent--;
+  line("}");
+  return monostate();
+}
+
+Obj CppEmitter::visitStmtExpression(Expression<Obj> *stmt) {
+  line(expression(stmt->expr) + ";");
+  return monostate();
+}
+
+Obj CppEmitter::visitStmtFunction(Function<Obj> *stmt) {
+  // Declared before the body, which may call the function recursively
+  string function;
+  if (scopes.empty())
+    function = global(stmt->name);
+  else
+    function = declare(stmt->name, "LoxValue()");
+
+  string args = stmt->params.empty() ? "" : "args";
+  line(function + " = loxFunction(" + to_string(stmt->params.size()) +
+       ", [=](const LoxValue *" + args + ") -> LoxValue {");
+  indent++;
+  functionDepth++;
+  beginScope();
+
+  int arg = 0;
+  for (auto &param : stmt->params)
+    declare(param, "args[" + to_string(arg++) + "]");
+
+  statements(stmt->body);
+  line("return LoxValue();");
+
+  endScope();
+  functionDepth--;
+  indent--;
+  line("});");
+  return monostate();
+}
+
+Obj CppEmitter::visitStmtIf(If<Obj> *stmt) {
+  line("if (loxTruthy(" + expression(stmt->condition) + ")) {");
+  indent++;
+  statement(stmt->thenBranch);
+  indent--;
+
+  if (stmt->elseBranch) {
+    line("} else {");
+    indent++;
+    statement(stmt->elseBranch);
+    indent--;
+  }
+
+  line("}");
+  return monostate();
+}
+
+Obj CppEmitter::visitStmtPrint(Print<Obj> *stmt) {
+  line("loxPrint(" + expression(stmt->expr) + ");");
+  return monostate();
+}
+
+Obj CppEmitter::visitStmtReturn(Return<Obj> *stmt) {
+  if (stmt->value)
+    line("return " + expression(stmt->value) + ";");
+  else
+    line("return LoxValue();");
+  return monostate();
+}
+
+Obj CppEmitter::visitStmtVar(Var<Obj> *stmt) {
+  string value = "LoxValue()";
+  if (stmt->initializer != nullptr)
+    value = expression(stmt->initializer);
+
+  declare(stmt->name, value);
+  return monostate();
+}
+
+Obj CppEmitter::visitStmtWhile(While<Obj> *stmt) {
+  line("while (loxTruthy(" + expression(stmt->condition) + ")) {");
+  indent++;
+  statement(stmt->body);
+  indent--;
+  line("}");
+  return monostate();
+}
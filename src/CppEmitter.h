@@ -0,0 +1,77 @@
+#ifndef CPP_EMITTER_H
+#define CPP_EMITTER_H
+
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Util.h"
+#include "gen/Expr.hpp"
+#include "gen/Stmt.hpp"
+
+using namespace std;
+
+// Ahead-of-time mode (--emit-cpp). Turns the resolved AST into a standalone
+// C++17 translation unit that uses src/runtime/LoxRuntime.h. Globals become
+// file statics, Lox functions become lambdas and locals become C++ locals,
+// except the ones a nested function refers to, which are moved to the heap
+class CppEmitter : ExprAstVisitor<Obj>, StmtAstVisitor<Obj> {
+public:
+  CppEmitter();
+  string emit(const vector<Stmt<Obj> *> &stmts);
+  Obj visitExprAssign(Assign<Obj> *expr) override;
+  Obj visitExprBinary(Binary<Obj> *expr) override;
+  Obj visitExprCall(Call<Obj> *expr) override;
+  Obj visitExprGrouping(Grouping<Obj> *expr) override;
+  Obj visitExprLiteral(Literal<Obj> *expr) override;
+  Obj visitExprLogical(Logical<Obj> *expr) override;
+  Obj visitExprUnary(Unary<Obj> *expr) override;
+  Obj visitExprVariable(Variable<Obj> *expr) override;
+  Obj visitStmtBlock(Block<Obj> *stmt) override;
+  Obj visitStmtExpression(Expression<Obj> *stmt) override;
+  Obj visitStmtFunction(Function<Obj> *stmt) override;
+  Obj visitStmtIf(If<Obj> *stmt) override;
+  Obj visitStmtPrint(Print<Obj> *stmt) override;
+  Obj visitStmtReturn(Return<Obj> *stmt) override;
+  Obj visitStmtVar(Var<Obj> *stmt) override;
+  Obj visitStmtWhile(While<Obj> *stmt) override;
+
+private:
+  struct Local {
+    const Token *declaration;
+    string name;
+  };
+
+  // Locals of each scope in slot order, mirroring the Resolver, and the
+  // function nesting each scope belongs to
+  vector<vector<Local>> scopes;
+  vector<int> scopeFunctions;
+  int functionDepth;
+  int localCount;
+  // Declarations a nested function refers to, found by the first pass
+  set<const Token *> captured;
+  set<string> globals;
+  map<string, int> strings;
+
+  ostringstream out;
+  int indent;
+  // C++ for the expression just visited
+  string code;
+
+  string expression(Expr<Obj> *expr);
+  void statement(Stmt<Obj> *stmt);
+  void statements(const list<Stmt<Obj> *> &stmts);
+  void line(const string &text);
+  void beginScope();
+  void endScope();
+  string declare(const Token &name, const string &value);
+  string reference(const Local &local);
+  string variable(int depth, int slot);
+  string global(const Token &name);
+  string number(double value);
+  string quote(const string &text);
+};
+
+#endif
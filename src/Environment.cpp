@@ -2,16 +2,20 @@
 
 #include <iostream>
 
+#include "Gc.h"
+#include "Interner.h"
 #include "Interpreter.h"
 using namespace std;
 
-Environment::Environment() { enclosing = nullptr; }
+Environment::Environment()
+    : HeapObj(OBJ_ENVIRONMENT), enclosing(nullptr), captured(false) {}
 
-Environment::Environment(Environment *enclosing) : enclosing(enclosing) {}
+Environment::Environment(Environment *enclosing)
+    : HeapObj(OBJ_ENVIRONMENT), enclosing(enclosing), captured(false) {}
 
 void Environment::assign(Token name, Obj val) {
-  if (values.find(name.lexeme) != values.end()) {
-    values[name.lexeme] = val;
+  if (name.symbol < (int)values.size() && !values[name.symbol].isUndefined()) {
+    values[name.symbol] = val;
     return;
   }
 
@@ -21,27 +25,82 @@ void Environment::assign(Token name, Obj val) {
     return;
   }
 
-  throw RuntimeError(name, string("Undefined variable '") + name.lexeme +
-                               string("'."));
+  throw RuntimeError(name, string("Undefined variable '") +
+                               string(name.lexeme) + string("'."));
 }
 
-void Environment::define(string name, Obj val) { values[name] = val; }
+void Environment::assignAt(int depth, int slot, Obj val) {
+  ancestor(depth)->slots[slot] = val;
+}
+
+void Environment::define(int symbol, Obj val) {
+  if (symbol >= (int)values.size())
+    values.resize(symbol + 1, Obj::undefined());
+
+  values[symbol] = val;
+}
+
+// Locals are defined in the same order the Resolver numbered them, so the
+// next slot is always the end of the vector
+void Environment::define(Obj val) { slots.push_back(val); }
 
 Obj Environment::get(Token name) {
-  if (values.find(name.lexeme) != values.end())
-    return values[name.lexeme];
+  if (name.symbol < (int)values.size() && !values[name.symbol].isUndefined())
+    return values[name.symbol];
 
   // Search in outer scope
   if (enclosing)
     return enclosing->get(name);
 
-  throw RuntimeError(name, string("Undefined variable '") + name.lexeme +
-                               string("'."));
+  throw RuntimeError(name, string("Undefined variable '") +
+                               string(name.lexeme) + string("'."));
+}
+
+Obj Environment::getAt(int depth, int slot) {
+  return ancestor(depth)->slots[slot];
+}
+
+Environment *Environment::ancestor(int depth) {
+  Environment *env = this;
+  for (int i = 0; i < depth; i++)
+    env = env->enclosing;
+
+  return env;
+}
+
+// A closure reaches every enclosing scope, so the whole chain is kept. The
+// ancestors of a captured environment are already captured
+void Environment::capture() {
+  for (Environment *env = this; env && !env->captured; env = env->enclosing)
+    env->captured = true;
 }
 
-void Environment::clear() { values.clear(); }
+bool Environment::isCaptured() { return captured; }
+
+// Prepares a recycled environment for a new scope, keeping the slot
+// storage it already has
+void Environment::reset(Environment *enclosing) {
+  this->enclosing = enclosing;
+  slots.clear();
+}
+
+void Environment::clear() {
+  values.clear();
+  slots.clear();
+}
+
+void Environment::trace(Gc &gc) {
+  for (auto &value : values)
+    gc.markValue(value);
+  for (auto &value : slots)
+    gc.markValue(value);
+  gc.markObject(enclosing);
+}
 
 void Environment::dumpValues() {
-  for (auto [k, v] : values)
-    cout << "env_dump " << k << endl;
+  for (size_t i = 0; i < values.size(); i++)
+    if (!values[i].isUndefined())
+      cout << "env_dump " << interner().name(i)->value << endl;
+  for (size_t i = 0; i < slots.size(); i++)
+    cout << "env_dump #" << i << endl;
 }
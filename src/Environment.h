@@ -3,24 +3,38 @@
 
 #include "Lex.h"
 #include "Util.h"
-#include <map>
 #include <string>
+#include <vector>
 
 using namespace std;
 
-class Environment {
+class Environment : public HeapObj {
 private:
-  map<string, Obj> values;
+  // Globals are indexed by symbol id, locals by the slot the Resolver gave
+  // them
+  vector<Obj> values;
+  vector<Obj> slots;
   Environment *enclosing;
+  // Set once a closure may outlive the scope, such environments are never
+  // recycled
+  bool captured;
 
 public:
   Environment();
   Environment(Environment *enclosing);
   void dumpValues();
-  void define(string name, Obj val);
+  void define(int symbol, Obj val);
+  void define(Obj val);
   void assign(Token name, Obj value);
+  void assignAt(int depth, int slot, Obj value);
   Obj get(Token name);
+  Obj getAt(int depth, int slot);
+  Environment *ancestor(int depth);
+  void capture();
+  bool isCaptured();
+  void reset(Environment *enclosing);
   void clear();
+  void trace(Gc &gc) override;
 };
 
 #endif
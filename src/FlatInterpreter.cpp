@@ -0,0 +1,277 @@
+#include "FlatInterpreter.h"
+
+#include <iostream>
+
+#include "Interner.h"
+
+using namespace std;
+
+// ----------------------------------------
+// Function definitions
+FlatCallable::FlatCallable(FlatInterpreter &engine, uint32_t function,
+                           Environment *closure)
+    : closure(closure), engine(engine), function(function) {}
+
+int FlatCallable::arity() {
+  return engine.ast.functionNodes[function].params.count;
+}
+
+Obj FlatCallable::call(list<Obj> arguments) {
+  return engine.callFunction(closure, arguments, [&](Environment *env) {
+    return engine.executeBlock(engine.ast.functionNodes[function].body, env);
+  });
+}
+
+string FlatCallable::to_string() {
+  return "<fn " + string(engine.ast.functionNodes[function].name.lexeme);
+}
+
+void FlatCallable::trace(Gc &gc) { gc.markObject(closure); }
+
+// ----------------------------------------
+// Engine definitions
+FlatInterpreter::FlatInterpreter(FlatAst &ast) : ast(ast) {}
+
+void FlatInterpreter::interpret() {
+  try {
+    for (uint32_t i = 0; i < ast.script.count; i++)
+      execute(ast.stmtLists[ast.script.begin + i]);
+  } catch (const RuntimeError &error) {
+    runtimeError(error);
+    temps.clear();
+  }
+}
+
+// stmts may be empty, with begin at the end of stmtLists
+Obj FlatInterpreter::executeBlock(FlatSpan stmts, Environment *env) {
+  const FlatRef *first = ast.stmtLists.data() + stmts.begin;
+  return runBlock(first, first + stmts.count, env,
+                  [this](FlatRef stmt) { return execute(stmt); });
+}
+
+void FlatInterpreter::checkNumberOperand(const Token &token, Obj left,
+                                         Obj right) {
+  if (left.isNumber() && right.isNumber())
+    return;
+  throw RuntimeError(token, "Operand must be a number!");
+}
+
+// ----------------------------------------
+// Expressions
+Obj FlatInterpreter::evaluate(FlatRef expr) {
+  uint32_t index = flatIndex(expr);
+
+  switch (flatKind(expr)) {
+  case FLAT_ASSIGN:
+    return assign(ast.assignNodes[index]);
+  case FLAT_BINARY:
+    return binary(ast.binaryNodes[index]);
+  case FLAT_CALL:
+    return call(ast.callNodes[index]);
+  case FLAT_GROUPING:
+    return evaluate(ast.groupingNodes[index].grouping);
+  case FLAT_LITERAL:
+    return ast.literalNodes[index].value;
+  case FLAT_LOGICAL:
+    return logical(ast.logicalNodes[index]);
+  case FLAT_UNARY:
+    return unary(ast.unaryNodes[index]);
+  case FLAT_VARIABLE:
+    return variable(ast.variableNodes[index]);
+  default:
+    return monostate();
+  }
+}
+
+Obj FlatInterpreter::assign(const FlatAssign &expr) {
+  Obj value = evaluate(expr.value);
+  if (expr.depth < 0)
+    globals->assign(expr.name, value);
+  else
+    env->assignAt(expr.depth, expr.slot, value);
+
+  return value;
+}
+
+Obj FlatInterpreter::binary(const FlatBinary &expr) {
+  Obj left = evaluate(expr.left);
+  temps.push_back(left);
+  Obj right = evaluate(expr.right);
+  temps.pop_back();
+
+  switch (expr.op.type) {
+  case GREATER:
+    checkNumberOperand(expr.op, left, right);
+    return left.asNumber() > right.asNumber();
+  case GREATER_EQUAL:
+    checkNumberOperand(expr.op, left, right);
+    return left.asNumber() >= right.asNumber();
+  case LESS:
+    checkNumberOperand(expr.op, left, right);
+    return left.asNumber() < right.asNumber();
+  case LESS_EQUAL:
+    checkNumberOperand(expr.op, left, right);
+    return left.asNumber() <= right.asNumber();
+  case EQUAL_EQUAL:
+    return left == right;
+  case BANG_EQUAL:
+    return left != right;
+  case PLUS:
+    if (left.isNumber() && right.isNumber())
+      return left.asNumber() + right.asNumber();
+
+    if (left.isString() && right.isString())
+      return newString(left.asString()->value + right.asString()->value);
+
+    throw RuntimeError(expr.op, "Operands must be two numbers or strings");
+  case MINUS:
+    checkNumberOperand(expr.op, left, right);
+    return left.asNumber() - right.asNumber();
+  case SLASH:
+    checkNumberOperand(expr.op, left, right);
+    return left.asNumber() / right.asNumber();
+  case STAR:
+    checkNumberOperand(expr.op, left, right);
+    return left.asNumber() * right.asNumber();
+  default:
+    return monostate();
+  }
+}
+
+Obj FlatInterpreter::call(const FlatCall &expr) {
+  // Callee and arguments are rooted until the call binds them, like in the
+  // Interpreter
+  size_t base = temps.size();
+  Obj callee = evaluate(expr.callee);
+  temps.push_back(callee);
+
+  list<Obj> arguments;
+  // An empty list may begin at the end of exprLists
+  const FlatRef *arg = ast.exprLists.data() + expr.arguments.begin;
+  for (uint32_t i = 0; i < expr.arguments.count; i++) {
+    arguments.push_back(evaluate(arg[i]));
+    temps.push_back(arguments.back());
+  }
+
+  if (!callee.isCallable())
+    throw RuntimeError(expr.paren, "Can only call functions and classes.");
+
+  Callable *function = callee.asCallable();
+  if ((int)arguments.size() != function->arity())
+    throw RuntimeError(expr.paren,
+                       string("Expected ") + to_string(function->arity()) +
+                           string(" arguments but got ") +
+                           to_string(arguments.size()) + string("."));
+
+  Obj result = function->call(arguments);
+  temps.resize(base);
+  return result;
+}
+
+Obj FlatInterpreter::logical(const FlatLogical &expr) {
+  Obj left = evaluate(expr.left);
+
+  if (expr.op.type == OR) {
+    if (isTrue(left))
+      return left;
+  } else {
+    if (!isTrue(left))
+      return left;
+  }
+
+  return evaluate(expr.right);
+}
+
+Obj FlatInterpreter::unary(const FlatUnary &expr) {
+  Obj right = evaluate(expr.right);
+
+  switch (expr.op.type) {
+  case MINUS:
+    if (!right.isNumber())
+      throw RuntimeError(expr.op, "Operand must be a number!");
+    return -right.asNumber();
+  case BANG:
+    return !isTrue(right);
+  default:
+    return monostate();
+  }
+}
+
+Obj FlatInterpreter::variable(const FlatVariable &expr) {
+  if (expr.depth < 0)
+    return globals->get(expr.name);
+  return env->getAt(expr.depth, expr.slot);
+}
+
+// ----------------------------------------
+// Statements
+Obj FlatInterpreter::execute(FlatRef stmt) {
+  uint32_t index = flatIndex(stmt);
+
+  switch (flatKind(stmt)) {
+  case FLAT_BLOCK:
+    return executeBlock(ast.blockNodes[index].statements, newEnvironment(env));
+  case FLAT_EXPRESSION:
+    evaluate(ast.expressionNodes[index].expr);
+    return monostate();
+  case FLAT_FUNCTION:
+    return function(index);
+  case FLAT_IF:
+    return ifStmt(ast.ifNodes[index]);
+  case FLAT_PRINT:
+    cout << to_string(evaluate(ast.printNodes[index].expr)) << endl;
+    return monostate();
+  case FLAT_RETURN:
+    return returnStmt(ast.returnNodes[index]);
+  case FLAT_VAR:
+    return var(ast.varNodes[index]);
+  case FLAT_WHILE:
+    return whileStmt(ast.whileNodes[index]);
+  default:
+    return monostate();
+  }
+}
+
+Obj FlatInterpreter::function(uint32_t index) {
+  auto function = gc().allocate<FlatCallable>(*this, index, env);
+  env->capture();
+  define(ast.functionNodes[index].name, function);
+  return monostate();
+}
+
+Obj FlatInterpreter::ifStmt(const FlatIf &stmt) {
+  if (isTrue(evaluate(stmt.condition)))
+    return execute(stmt.thenBranch);
+  else if (stmt.elseBranch != FLAT_NONE)
+    return execute(stmt.elseBranch);
+
+  return monostate();
+}
+
+Obj FlatInterpreter::returnStmt(const FlatReturn &stmt) {
+  Obj value = monostate();
+  if (stmt.value != FLAT_NONE)
+    value = evaluate(stmt.value);
+
+  completion = COMPLETION_RETURN;
+  return value;
+}
+
+Obj FlatInterpreter::var(const FlatVar &stmt) {
+  Obj value = monostate();
+  if (stmt.initializer != FLAT_NONE)
+    value = evaluate(stmt.initializer);
+
+  define(stmt.name, value);
+  return monostate();
+}
+
+Obj FlatInterpreter::whileStmt(const FlatWhile &stmt) {
+  while (isTrue(evaluate(stmt.condition))) {
+    Obj value = execute(stmt.body);
+    if (completion == COMPLETION_RETURN)
+      return value;
+  }
+
+  return monostate();
+}
@@ -0,0 +1,64 @@
+#ifndef FLAT_INTERPRETER_H
+#define FLAT_INTERPRETER_H
+
+#include <list>
+#include <vector>
+
+#include "Callable.h"
+#include "Environment.h"
+#include "Gc.h"
+#include "Interpreter.h"
+#include "ScopedEngine.h"
+#include "Util.h"
+#include "gen/FlatAst.hpp"
+
+using namespace std;
+
+class FlatInterpreter;
+
+class FlatCallable : public Callable {
+public:
+  Environment *closure;
+  FlatCallable(FlatInterpreter &engine, uint32_t function,
+               Environment *closure);
+  int arity() override;
+  Obj call(list<Obj> arguments) override;
+  string to_string() override;
+  void trace(Gc &gc) override;
+
+private:
+  FlatInterpreter &engine;
+  // Index in FlatAst::functionNodes
+  uint32_t function;
+};
+
+// Engine selected with --engine=flat. Walks the FlatAst built from the
+// resolved tree: nodes sit in one array per type and child lists are
+// contiguous, so a loop body is read front to back instead of chasing list
+// nodes. Dispatch is a switch on the kind bits of each reference. Scopes
+// work like in the Interpreter
+class FlatInterpreter : public ScopedEngine {
+public:
+  FlatAst &ast;
+  FlatInterpreter(FlatAst &ast);
+  void interpret();
+  Obj executeBlock(FlatSpan stmts, Environment *env);
+
+private:
+  Obj evaluate(FlatRef expr);
+  Obj assign(const FlatAssign &expr);
+  Obj binary(const FlatBinary &expr);
+  Obj call(const FlatCall &expr);
+  Obj logical(const FlatLogical &expr);
+  Obj unary(const FlatUnary &expr);
+  Obj variable(const FlatVariable &expr);
+  Obj execute(FlatRef stmt);
+  Obj function(uint32_t index);
+  Obj ifStmt(const FlatIf &stmt);
+  Obj returnStmt(const FlatReturn &stmt);
+  Obj var(const FlatVar &stmt);
+  Obj whileStmt(const FlatWhile &stmt);
+  void checkNumberOperand(const Token &token, Obj left, Obj right);
+};
+
+#endif
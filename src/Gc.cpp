@@ -0,0 +1,96 @@
+#include "Gc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "Interner.h"
+
+using namespace std;
+
+void Gc::reserve(size_t size) {
+  if (bytesAllocated + size > max(nextGc, threshold))
+    collect();
+}
+
+void Gc::track(HeapObj *object, size_t size) {
+  object->size = size;
+  object->next = objects;
+  objects = object;
+
+  bytesAllocated += size;
+  totalAllocated += size;
+}
+
+void Gc::addRoots(GcRoots *source) { roots.push_back(source); }
+
+void Gc::removeRoots(GcRoots *source) {
+  roots.erase(remove(roots.begin(), roots.end(), source), roots.end());
+}
+
+void Gc::markObject(HeapObj *object) {
+  if (object == nullptr || object->marked)
+    return;
+
+  object->marked = true;
+  gray.push_back(object);
+}
+
+void Gc::markValue(Obj value) {
+  if (value.isObj())
+    markObject(value.asObj());
+}
+
+void Gc::collect() {
+  auto start = chrono::steady_clock::now();
+
+  for (auto source : roots)
+    source->markRoots(*this);
+  traceReferences();
+
+  // The string table holds its entries weakly, drop the ones about to go
+  interner().removeUnmarked();
+  sweep();
+
+  nextGc = bytesAllocated * growth;
+  collections++;
+  pauseSeconds +=
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void Gc::printStats() {
+  cerr << "gc: " << collections << " collections, " << totalAllocated
+       << " bytes allocated, " << bytesFreed << " bytes freed, "
+       << bytesAllocated << " bytes live, " << pauseSeconds * 1000
+       << " ms paused" << endl;
+}
+
+void Gc::traceReferences() {
+  while (!gray.empty()) {
+    HeapObj *object = gray.back();
+    gray.pop_back();
+    object->trace(*this);
+  }
+}
+
+void Gc::sweep() {
+  HeapObj **link = &objects;
+  while (*link != nullptr) {
+    HeapObj *object = *link;
+    if (object->marked || object->pinned) {
+      object->marked = false;
+      link = &object->next;
+      continue;
+    }
+
+    *link = object->next;
+    bytesAllocated -= object->size;
+    bytesFreed += object->size;
+    delete object;
+  }
+}
+
+Gc &gc() {
+  static Gc instance;
+  return instance;
+}
@@ -0,0 +1,65 @@
+#ifndef GC_H
+#define GC_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "Object.h"
+
+using namespace std;
+
+class Gc;
+
+// Anything holding values the collector can't see, an engine's globals and
+// stacks, registers itself and marks them on every collection
+class GcRoots {
+public:
+  virtual void markRoots(Gc &gc) = 0;
+};
+
+// Mark-and-sweep collector over every HeapObj. A collection runs before an
+// allocation once the bytes allocated since the last one pass nextGc
+class Gc {
+public:
+  // Heap size that triggers the first collection
+  size_t threshold = 1024 * 1024;
+  // After a collection the next one waits until the heap grows by this factor
+  double growth = 2;
+
+  // Counters reported by --gc-stats
+  size_t bytesAllocated = 0;
+  size_t totalAllocated = 0;
+  size_t bytesFreed = 0;
+  size_t collections = 0;
+  double pauseSeconds = 0;
+
+  template <typename T, typename... Args> T *allocate(Args &&...args) {
+    reserve(sizeof(T));
+    T *object = new T(std::forward<Args>(args)...);
+    track(object, sizeof(T));
+    return object;
+  }
+
+  void reserve(size_t size);
+  void track(HeapObj *object, size_t size);
+  void addRoots(GcRoots *source);
+  void removeRoots(GcRoots *source);
+  void markObject(HeapObj *object);
+  void markValue(Obj value);
+  void collect();
+  void printStats();
+
+private:
+  HeapObj *objects = nullptr;
+  size_t nextGc = 0;
+  vector<HeapObj *> gray;
+  vector<GcRoots *> roots;
+
+  void traceReferences();
+  void sweep();
+};
+
+Gc &gc();
+
+#endif
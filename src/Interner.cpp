@@ -0,0 +1,58 @@
+#include "Interner.h"
+
+using namespace std;
+
+Interner::Interner() { gc().addRoots(this); }
+
+StringObj *Interner::intern(string_view chars) {
+  auto itr = strings.find(chars);
+  if (itr != strings.end())
+    return itr->second;
+
+  // Strings are charged for their characters too
+  gc().reserve(sizeof(StringObj) + chars.size());
+  StringObj *string = new StringObj(std::string(chars));
+  gc().track(string, sizeof(StringObj) + chars.size());
+
+  strings.emplace(string->value, string);
+  return string;
+}
+
+// Ids are handed out on first use as a name, so plain string values never
+// take up room in the globals tables
+int Interner::symbol(StringObj *name) {
+  if (name->symbol == -1) {
+    name->symbol = symbols.size();
+    symbols.push_back(name);
+  }
+
+  return name->symbol;
+}
+
+int Interner::symbol(string_view name) { return symbol(intern(name)); }
+
+StringObj *Interner::name(int symbol) { return symbols[symbol]; }
+
+int Interner::symbolCount() { return symbols.size(); }
+
+// Called between marking and sweeping, so unmarked strings are about to be
+// freed
+void Interner::removeUnmarked() {
+  for (auto itr = strings.begin(); itr != strings.end();) {
+    if (itr->second->marked || itr->second->pinned)
+      itr++;
+    else
+      itr = strings.erase(itr);
+  }
+}
+
+// Engines index their globals by symbol id, so names are never collected
+void Interner::markRoots(Gc &gc) {
+  for (auto symbol : symbols)
+    gc.markObject(symbol);
+}
+
+Interner &interner() {
+  static Interner instance;
+  return instance;
+}
@@ -0,0 +1,36 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Gc.h"
+#include "Object.h"
+
+using namespace std;
+
+// Process-wide string table. Every string value goes through here, so two
+// strings with the same contents are the same StringObj and compare by
+// pointer. Identifiers additionally get a dense symbol id that engines use
+// to index their globals. Strings are held weakly, symbols for good
+class Interner : public GcRoots {
+public:
+  StringObj *intern(string_view chars);
+  Interner();
+  int symbol(StringObj *name);
+  int symbol(string_view name);
+  StringObj *name(int symbol);
+  int symbolCount();
+  void removeUnmarked();
+  void markRoots(Gc &gc) override;
+
+private:
+  // Keys view the value of the StringObj they map to
+  unordered_map<string_view, StringObj *> strings;
+  vector<StringObj *> symbols;
+};
+
+Interner &interner();
+
+#endif
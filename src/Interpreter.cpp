@@ -6,21 +6,26 @@
 #include <variant>
 
 #include "Callable.h"
-#include "Return.h"
+#include "Gc.h"
+#include "Interner.h"
 
 using namespace std;
 
-Interpreter::Interpreter() : err(false) {
-  // Initialize environments
-  globals = new Environment();
-  env = globals;
-
-  globals->define("clock", new ClockCallable());
+// A specialized site saw a type it wasn't built for and stays generic from
+// now on, so a polymorphic site can't flip back and forth
+template <typename Node> static void deoptimize(Node *expr) {
+  expr->quick = QUICK_GENERIC;
+  expr->deopts++;
 }
 
+Interpreter::Interpreter() : quickeningStats(false) {}
+
 Obj Interpreter::visitExprAssign(Assign<Obj> *expr) {
   Obj value = evaluate(expr->value);
-  env->assign(expr->name, value);
+  if (expr->depth < 0)
+    globals->assign(expr->name, value);
+  else
+    env->assignAt(expr->depth, expr->slot, value);
 
   return value;
 }
@@ -30,6 +35,17 @@ Obj Interpreter::visitExprLiteral(Literal<Obj> *expr) { return expr->value; }
 Obj Interpreter::visitExprLogical(Logical<Obj> *expr) {
   Obj left = evaluate(expr->left);
 
+  if (expr->quick == QUICK_LOGICAL_BOOL) {
+    if (left.isBool()) {
+      if (left.asBool() == (expr->op.type == OR))
+        return left;
+      return evaluate(expr->right);
+    }
+    deoptimize(expr);
+  } else if (expr->quick == QUICK_UNSEEN) {
+    quicken(expr, left);
+  }
+
   if (expr->op.type == OR) {
     if (isTrue(left))
       return left;
@@ -48,12 +64,30 @@ Obj Interpreter::visitExprGrouping(Grouping<Obj> *expr) {
 Obj Interpreter::visitExprUnary(Unary<Obj> *expr) {
   Obj right = evaluate(expr->right);
 
+  switch (expr->quick) {
+  case QUICK_NEGATE_NUMBER:
+    if (right.isNumber())
+      return -right.asNumber();
+    deoptimize(expr);
+    break;
+  case QUICK_NOT_BOOL:
+    if (right.isBool())
+      return !right.asBool();
+    deoptimize(expr);
+    break;
+  case QUICK_UNSEEN:
+    quicken(expr, right);
+    break;
+  default:
+    break;
+  }
+
   switch (expr->op.type) {
   case MINUS:
     checkNumberOperand(expr->op, right);
-    return -get<double>(right);
+    return -right.asNumber();
   case BANG:
-    return isTrue(right);
+    return !isTrue(right);
   default:
     break;
   }
@@ -62,75 +96,122 @@ Obj Interpreter::visitExprUnary(Unary<Obj> *expr) {
 }
 
 Obj Interpreter::visitStmtBlock(Block<Obj> *stmt) {
-  executeBlock(stmt->statements, new Environment(env));
-  return monostate();
+  return executeBlock(stmt->statements, newEnvironment(env));
 }
 
 Obj Interpreter::visitExprVariable(Variable<Obj> *expr) {
-  return env->get(expr->name);
+  if (expr->depth < 0)
+    return globals->get(expr->name);
+  return env->getAt(expr->depth, expr->slot);
 }
 
 Obj Interpreter::visitExprCall(Call<Obj> *expr) {
+  // Callee and arguments live only in C++ locals until the call binds them,
+  // so they are kept on the temporary roots meanwhile
+  size_t base = temps.size();
   auto callee = evaluate(expr->callee);
+  temps.push_back(callee);
 
   list<Obj> arguments;
-  for (auto arg : expr->arguments)
+  for (auto arg : expr->arguments) {
     arguments.push_back(evaluate(arg));
+    temps.push_back(arguments.back());
+  }
 
-  if (!holds_alternative<Callable *>(callee))
+  if (!callee.isCallable())
     throw RuntimeError(expr->paren, "Can only call functions and classes.");
 
-  Callable *function = get<Callable *>(callee);
+  Callable *function = callee.asCallable();
   if (arguments.size() != function->arity())
     throw RuntimeError(expr->paren,
-                       to_string("Expected ") + to_string(function->arity()) +
-                           to_string(" arguments but got ") +
-                           to_string(arguments.size()) + to_string('.'));
-  return function->call(*this, arguments);
+                       string("Expected ") + to_string(function->arity()) +
+                           string(" arguments but got ") +
+                           to_string(arguments.size()) + string("."));
+
+  Obj result;
+  try {
+    result = function->call(arguments);
+  } catch (const BodyError &error) {
+    throw RuntimeError(expr->paren, error.what());
+  }
+  temps.resize(base);
+  return result;
 }
 
+// Fast path of a site specialized for two numbers
+#define QUICK_NUMBERS(state, op)                                               \
+  case state:                                                                  \
+    if (left.isNumber() && right.isNumber())                                   \
+      return left.asNumber() op right.asNumber();                              \
+    deoptimize(expr);                                                          \
+    break;
+
 Obj Interpreter::visitExprBinary(Binary<Obj> *expr) {
   Obj left = evaluate(expr->left);
+  temps.push_back(left);
   Obj right = evaluate(expr->right);
+  temps.pop_back();
+
+  // Specialized sites skip the operator switch and the operand checks
+  switch (expr->quick) {
+    QUICK_NUMBERS(QUICK_ADD_NUMBERS, +)
+    QUICK_NUMBERS(QUICK_SUBTRACT_NUMBERS, -)
+    QUICK_NUMBERS(QUICK_MULTIPLY_NUMBERS, *)
+    QUICK_NUMBERS(QUICK_DIVIDE_NUMBERS, /)
+    QUICK_NUMBERS(QUICK_GREATER_NUMBERS, >)
+    QUICK_NUMBERS(QUICK_GREATER_EQUAL_NUMBERS, >=)
+    QUICK_NUMBERS(QUICK_LESS_NUMBERS, <)
+    QUICK_NUMBERS(QUICK_LESS_EQUAL_NUMBERS, <=)
+    QUICK_NUMBERS(QUICK_EQUAL_NUMBERS, ==)
+    QUICK_NUMBERS(QUICK_NOT_EQUAL_NUMBERS, !=)
+  case QUICK_CONCAT_STRINGS:
+    if (left.isString() && right.isString())
+      return newString(left.asString()->value + right.asString()->value);
+    deoptimize(expr);
+    break;
+  case QUICK_UNSEEN:
+    quicken(expr, left, right);
+    break;
+  default:
+    break;
+  }
 
   switch (expr->op.type) {
   case GREATER:
     checkNumberOperand(expr->op, left, right);
-    return get<double>(left) > get<double>(right);
+    return left.asNumber() > right.asNumber();
   case GREATER_EQUAL:
     checkNumberOperand(expr->op, left, right);
-    return get<double>(left) >= get<double>(right);
+    return left.asNumber() >= right.asNumber();
   case LESS:
     checkNumberOperand(expr->op, left, right);
-    return get<double>(left) < get<double>(right);
+    return left.asNumber() < right.asNumber();
   case LESS_EQUAL:
     checkNumberOperand(expr->op, left, right);
-    return get<double>(left) <= get<double>(right);
+    return left.asNumber() <= right.asNumber();
   case EQUAL_EQUAL:
-    checkNumberOperand(expr->op, left, right);
     return isEqual(left, right);
   case BANG_EQUAL:
-    checkNumberOperand(expr->op, left, right);
     return !isEqual(left, right);
   case PLUS:
-    if (holds_alternative<double>(left) && holds_alternative<double>(right))
-      return get<double>(left) + get<double>(right);
+    if (left.isNumber() && right.isNumber())
+      return left.asNumber() + right.asNumber();
 
-    if (holds_alternative<string>(left) && holds_alternative<string>(right))
-      return get<string>(left) + get<string>(right);
+    if (left.isString() && right.isString())
+      return newString(left.asString()->value + right.asString()->value);
 
     throw RuntimeError(expr->op, "Operands must be two numbers or strings");
 
     break;
   case MINUS:
     checkNumberOperand(expr->op, left, right);
-    return get<double>(left) - get<double>(right);
+    return left.asNumber() - right.asNumber();
   case SLASH:
     checkNumberOperand(expr->op, left, right);
-    return get<double>(left) / get<double>(right);
+    return left.asNumber() / right.asNumber();
   case STAR:
     checkNumberOperand(expr->op, left, right);
-    return get<double>(left) * get<double>(right);
+    return left.asNumber() * right.asNumber();
   default:
     break;
   }
@@ -138,23 +219,107 @@ Obj Interpreter::visitExprBinary(Binary<Obj> *expr) {
   return monostate();
 }
 
+#undef QUICK_NUMBERS
+
+void Interpreter::quicken(Binary<Obj> *expr, Obj left, Obj right) {
+  expr->quick = QUICK_GENERIC;
+
+  if (left.isNumber() && right.isNumber()) {
+    switch (expr->op.type) {
+    case PLUS:
+      expr->quick = QUICK_ADD_NUMBERS;
+      break;
+    case MINUS:
+      expr->quick = QUICK_SUBTRACT_NUMBERS;
+      break;
+    case STAR:
+      expr->quick = QUICK_MULTIPLY_NUMBERS;
+      break;
+    case SLASH:
+      expr->quick = QUICK_DIVIDE_NUMBERS;
+      break;
+    case GREATER:
+      expr->quick = QUICK_GREATER_NUMBERS;
+      break;
+    case GREATER_EQUAL:
+      expr->quick = QUICK_GREATER_EQUAL_NUMBERS;
+      break;
+    case LESS:
+      expr->quick = QUICK_LESS_NUMBERS;
+      break;
+    case LESS_EQUAL:
+      expr->quick = QUICK_LESS_EQUAL_NUMBERS;
+      break;
+    case EQUAL_EQUAL:
+      expr->quick = QUICK_EQUAL_NUMBERS;
+      break;
+    case BANG_EQUAL:
+      expr->quick = QUICK_NOT_EQUAL_NUMBERS;
+      break;
+    default:
+      break;
+    }
+  } else if (expr->op.type == PLUS && left.isString() && right.isString()) {
+    expr->quick = QUICK_CONCAT_STRINGS;
+  }
+
+  recordSite(expr->op, &expr->quick, &expr->deopts);
+}
+
+void Interpreter::quicken(Unary<Obj> *expr, Obj right) {
+  if (expr->op.type == MINUS && right.isNumber())
+    expr->quick = QUICK_NEGATE_NUMBER;
+  else if (expr->op.type == BANG && right.isBool())
+    expr->quick = QUICK_NOT_BOOL;
+  else
+    expr->quick = QUICK_GENERIC;
+
+  recordSite(expr->op, &expr->quick, &expr->deopts);
+}
+
+void Interpreter::quicken(Logical<Obj> *expr, Obj left) {
+  expr->quick = left.isBool() ? QUICK_LOGICAL_BOOL : QUICK_GENERIC;
+  recordSite(expr->op, &expr->quick, &expr->deopts);
+}
+
+void Interpreter::recordSite(const Token &op, Quickening *quick, int *deopts) {
+  if (quickeningStats)
+    quickSites.push_back({op.line, op.lexeme, quick, deopts});
+}
+
+// Sites point into the AST, so this runs while the unit is still alive
+void Interpreter::printQuickeningStats() {
+  int specialized = 0;
+  for (auto &site : quickSites) {
+    if (*site.quick != QUICK_GENERIC)
+      specialized++;
+
+    cerr << "[line " << site.line << "] '" << site.op << "' "
+         << quickeningName(*site.quick) << ", " << *site.deopts << " deopts"
+         << endl;
+  }
+
+  cerr << "quickening: " << quickSites.size() << " sites, " << specialized
+       << " specialized" << endl;
+}
+
 Obj Interpreter::visitStmtExpression(Expression<Obj> *stmt) {
   evaluate(reinterpret_cast<Expr<Obj> *>(stmt->expr));
   return monostate();
 }
 
 Obj Interpreter::visitStmtFunction(Function<Obj> *stmt) {
-  FunctionCallable *function = new FunctionCallable(stmt, env);
-  env->define(stmt->name.lexeme, function);
+  auto function = gc().allocate<FunctionCallable>(*this, stmt, env);
+  env->capture();
+  define(stmt->name, function);
   return monostate();
 }
 
 Obj Interpreter::visitStmtIf(If<Obj> *stmt) {
-  if (isTrue(evaluate(stmt->condition))) {
-    execute(stmt->thenBranch);
-  } else if (stmt->elseBranch) {
-    execute(stmt->elseBranch);
-  }
+  if (isTrue(evaluate(stmt->condition)))
+    return execute(stmt->thenBranch);
+  else if (stmt->elseBranch)
+    return execute(stmt->elseBranch);
 
   return monostate();
 }
@@ -171,9 +336,10 @@ Obj Interpreter::visitStmtReturn(Return<Obj> *stmt) {
   if (stmt->value)
     value = evaluate(stmt->value);
 
-  throw ReturnError(value);
-
-  return monostate();
+  // Enclosing statements see the completion and stop, the value travels back
+  // through their return values up to FunctionCallable::call
+  completion = COMPLETION_RETURN;
+  return value;
 }
 
 Obj Interpreter::visitStmtVar(Var<Obj> *stmt) {
@@ -181,30 +347,24 @@ Obj Interpreter::visitStmtVar(Var<Obj> *stmt) {
   if (stmt->initializer != nullptr)
     val = evaluate(stmt->initializer);
 
-  env->define(stmt->name.lexeme, val);
+  define(stmt->name, val);
   return monostate();
 }
 
 Obj Interpreter::visitStmtWhile(While<Obj> *stmt) {
-  while (isTrue(evaluate(stmt->condition)))
-    execute(stmt->body);
+  while (isTrue(evaluate(stmt->condition))) {
+    Obj value = execute(stmt->body);
+    if (completion == COMPLETION_RETURN)
+      return value;
+  }
 
   return monostate();
 }
 
-Obj Interpreter::evaluate(Expr<Obj> *expr) { return expr->accept(this); }
-
-bool Interpreter::isTrue(Obj value) {
-  if (holds_alternative<monostate>(value))
-    return false;
-  else if (holds_alternative<bool>(value))
-    return get<bool>(value);
-  else
-    return true;
-}
+Obj Interpreter::evaluate(Expr<Obj> *expr) { return dispatchExpr(*this, expr); }
 
 void Interpreter::checkNumberOperand(Token token, Obj operand) {
-  if (holds_alternative<double>(operand))
+  if (operand.isNumber())
     return;
   throw RuntimeError(token, "Operand must be a number!");
 }
@@ -214,27 +374,16 @@ void Interpreter::checkNumberOperand(Token token, Obj left, Obj right) {
   checkNumberOperand(token, right);
 }
 
-bool Interpreter::isEqual(Obj v1, Obj v2) {
-  if (holds_alternative<monostate>(v1) && holds_alternative<monostate>(v2))
-    return true;
-  else if (holds_alternative<monostate>(v1))
-    return false;
-  else
-    return v1 == v2;
-}
-
-void Interpreter::execute(Stmt<Obj> *stmt) { stmt->accept(this); }
+// Any two values can be compared, strings are interned so this never looks
+// at their contents
+bool Interpreter::isEqual(Obj v1, Obj v2) { return v1 == v2; }
 
-void Interpreter::executeBlock(list<Stmt<Obj> *> stmts, Environment *env) {
-  Environment *previous = this->env;
-  try {
-    this->env = env;
+Obj Interpreter::execute(Stmt<Obj> *stmt) { return dispatchStmt(*this, stmt); }
 
-    for (auto s : stmts)
-      execute(s);
-  } catch (const RuntimeError &err) {
-    this->env = previous;
-  }
+Obj Interpreter::executeBlock(const list<Stmt<Obj> *> &stmts,
+                              Environment *env) {
+  return runBlock(stmts.begin(), stmts.end(), env,
+                  [this](Stmt<Obj> *stmt) { return execute(stmt); });
 }
 
 void Interpreter::interpret(vector<Stmt<Obj> *> statements) {
@@ -243,10 +392,6 @@ void Interpreter::interpret(vector<Stmt<Obj> *> statements) {
       execute(statement);
   } catch (const RuntimeError &err) {
     runtimeError(err);
+    temps.clear();
   }
 }
-
-void Interpreter::runtimeError(const RuntimeError &error) {
-  cout << "[line " + to_string(error.token.line) + "] " << error.what() << endl;
-  err = true;
-}
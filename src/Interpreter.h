@@ -2,25 +2,23 @@
 #define INTERPRETER_H
 
 #include <list>
-#include <stdexcept>
 #include <string>
 
 #include "Environment.h"
+#include "Gc.h"
+#include "ScopedEngine.h"
 #include "Util.h"
 #include "gen/Expr.hpp"
 #include "gen/Stmt.hpp"
 
-class RuntimeError : public runtime_error {
+// final, so evaluate and execute can dispatch on the node kind and call the
+// visit methods directly instead of going through accept
+class Interpreter final : ExprAstVisitor<Obj>,
+                          StmtAstVisitor<Obj>,
+                          public ScopedEngine {
 public:
-  Token token;
-  RuntimeError(Token token, string message)
-      : runtime_error(message), token(token) {}
-};
-
-class Interpreter : ExprAstVisitor<Obj>, StmtAstVisitor<Obj> {
-public:
-  bool err;
-  Environment *globals;
+  // Record every site that specializes, for printQuickeningStats
+  bool quickeningStats;
   Interpreter();
   Obj visitExprAssign(Assign<Obj> *expr) override;
   Obj visitExprBinary(Binary<Obj> *expr) override;
@@ -38,19 +36,27 @@ public:
   Obj visitStmtReturn(Return<Obj> *expr) override;
   Obj visitStmtVar(Var<Obj> *stmt) override;
   Obj visitStmtWhile(While<Obj> *stmt) override;
-  void execute(Stmt<Obj> *stmt);
-  void executeBlock(list<Stmt<Obj> *> stmts, Environment *env);
+  Obj execute(Stmt<Obj> *stmt);
+  Obj executeBlock(const list<Stmt<Obj> *> &stmts, Environment *env);
+  void printQuickeningStats();
   void interpret(vector<Stmt<Obj> *> expr);
 
 private:
-  Environment *env;
+  struct QuickSite {
+    int line;
+    string_view op;
+    Quickening *quick;
+    int *deopts;
+  };
+  vector<QuickSite> quickSites;
   Obj evaluate(Expr<Obj> *expr);
-  void assign(Token name, Obj value);
-  bool isTrue(Obj value);
   bool isEqual(Obj v1, Obj v2);
   void checkNumberOperand(Token token, Obj operand);
   void checkNumberOperand(Token token, Obj left, Obj right);
-  void runtimeError(const RuntimeError &err);
+  void quicken(Binary<Obj> *expr, Obj left, Obj right);
+  void quicken(Unary<Obj> *expr, Obj right);
+  void quicken(Logical<Obj> *expr, Obj left);
+  void recordSite(const Token &op, Quickening *quick, int *deopts);
 };
 
 #endif
@@ -0,0 +1,404 @@
+#include "Jit.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+using namespace std;
+
+Jit::~Jit() {
+#if JIT_SUPPORTED
+  for (auto &region : regions)
+    munmap(region.first, region.second);
+#endif
+}
+
+JitEntry Jit::compile(Function<Obj> *function) {
+  if (!JIT_SUPPORTED || function->params.size() > JIT_MAX_LOCALS)
+    return nullptr;
+
+  code.clear();
+  scopes.clear();
+
+  // Parameters and body share the function scope, arguments are copied to
+  // the first frame entries by run
+  frameSize = function->params.size();
+  scopes.push_back({});
+  for (int i = 0; i < frameSize; i++)
+    scopes.back().push_back(i);
+
+  try {
+    compile(function->body);
+  } catch (const Unsupported &) {
+    return nullptr;
+  }
+
+  // Ran off the end, the call evaluates to nil
+  emit({0x31, 0xC0}); // xor eax, eax
+  emit({0xC3});       // ret
+  return install();
+}
+
+bool Jit::run(JitEntry entry, const list<Obj> &arguments, Obj &result) {
+  double frame[JIT_MAX_LOCALS];
+  int i = 0;
+  for (auto &arg : arguments) {
+    // Compiled code only deals with doubles, anything else is interpreted
+    if (!arg.isNumber())
+      return false;
+    frame[i++] = arg.asNumber();
+  }
+
+  double value;
+  if (entry(frame, &value))
+    result = value;
+  else
+    result = monostate();
+
+  return true;
+}
+
+void Jit::compile(const list<Stmt<Obj> *> &stmts) {
+  for (auto stmt : stmts)
+    compile(stmt);
+}
+
+void Jit::compile(Stmt<Obj> *stmt) { stmt->accept(this); }
+
+// Leaves the value of expr in xmm0
+void Jit::compile(Expr<Obj> *expr) { expr->accept(this); }
+
+// Falls through when expr holds, otherwise jumps to one of falseJumps, which
+// the caller patches
+void Jit::condition(Expr<Obj> *expr, vector<size_t> &falseJumps) {
+  if (auto grouping = dynamic_cast<Grouping<Obj> *>(expr)) {
+    condition(grouping->grouping, falseJumps);
+    return;
+  }
+
+  if (auto logical = dynamic_cast<Logical<Obj> *>(expr)) {
+    if (logical->op.type == AND) {
+      condition(logical->left, falseJumps);
+      condition(logical->right, falseJumps);
+      return;
+    }
+
+    vector<size_t> leftFalse;
+    condition(logical->left, leftFalse);
+    size_t taken = jump({0xE9}); // jmp
+    for (auto at : leftFalse)
+      patch(at);
+    condition(logical->right, falseJumps);
+    patch(taken);
+    return;
+  }
+
+  auto binary = dynamic_cast<Binary<Obj> *>(expr);
+  if (!binary)
+    throw Unsupported();
+
+  TokenType op = binary->op.type;
+  if (op != LESS && op != LESS_EQUAL && op != GREATER &&
+      op != GREATER_EQUAL && op != EQUAL_EQUAL && op != BANG_EQUAL)
+    throw Unsupported();
+
+  compile(binary->left);
+  push();
+  compile(binary->right);
+  popRight();
+
+  // Conditions are chosen so an unordered compare, a NaN operand, is false
+  switch (op) {
+  case LESS:
+    emit({0x66, 0x0F, 0x2E, 0xC8});               // ucomisd xmm1, xmm0
+    falseJumps.push_back(jump({0x0F, 0x86}));     // jbe
+    break;
+  case LESS_EQUAL:
+    emit({0x66, 0x0F, 0x2E, 0xC8});               // ucomisd xmm1, xmm0
+    falseJumps.push_back(jump({0x0F, 0x82}));     // jb
+    break;
+  case GREATER:
+    emit({0x66, 0x0F, 0x2E, 0xC1});               // ucomisd xmm0, xmm1
+    falseJumps.push_back(jump({0x0F, 0x86}));     // jbe
+    break;
+  case GREATER_EQUAL:
+    emit({0x66, 0x0F, 0x2E, 0xC1});               // ucomisd xmm0, xmm1
+    falseJumps.push_back(jump({0x0F, 0x82}));     // jb
+    break;
+  case EQUAL_EQUAL:
+    emit({0x66, 0x0F, 0x2E, 0xC1});               // ucomisd xmm0, xmm1
+    falseJumps.push_back(jump({0x0F, 0x85}));     // jne
+    falseJumps.push_back(jump({0x0F, 0x8A}));     // jp
+    break;
+  default:
+    emit({0x66, 0x0F, 0x2E, 0xC1});               // ucomisd xmm0, xmm1
+    emit({0x7A, 0x06});                           // jp over the je
+    falseJumps.push_back(jump({0x0F, 0x84}));     // je
+    break;
+  }
+}
+
+// Variables from outside the function live in closures, not in the frame
+int Jit::frameIndex(int depth, int slot) {
+  int scope = (int)scopes.size() - 1 - depth;
+  if (depth < 0 || scope < 0 || slot >= (int)scopes[scope].size())
+    throw Unsupported();
+
+  return scopes[scope][slot];
+}
+
+// Slots are numbered in declaration order, so the next one is the end of the
+// innermost scope
+int Jit::declareLocal() {
+  if (frameSize == JIT_MAX_LOCALS)
+    throw Unsupported();
+
+  scopes.back().push_back(frameSize);
+  return frameSize++;
+}
+
+JitEntry Jit::install() {
+#if JIT_SUPPORTED
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t size = (code.size() + page - 1) / page * page;
+
+  void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED)
+    return nullptr;
+
+  // Written first, then made executable, never both at once
+  memcpy(memory, code.data(), code.size());
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, size);
+    return nullptr;
+  }
+
+  regions.push_back({memory, size});
+  return reinterpret_cast<JitEntry>(memory);
+#else
+  return nullptr;
+#endif
+}
+
+// ----------------------------------------
+// Code emission
+void Jit::emit(initializer_list<uint8_t> bytes) {
+  code.insert(code.end(), bytes);
+}
+
+void Jit::emit32(uint32_t value) {
+  for (int i = 0; i < 4; i++)
+    code.push_back(value >> (8 * i));
+}
+
+void Jit::emit64(uint64_t value) {
+  for (int i = 0; i < 8; i++)
+    code.push_back(value >> (8 * i));
+}
+
+void Jit::loadLocal(int index) {
+  emit({0xF2, 0x0F, 0x10, 0x87}); // movsd xmm0, [rdi + disp32]
+  emit32(index * sizeof(double));
+}
+
+void Jit::storeLocal(int index) {
+  emit({0xF2, 0x0F, 0x11, 0x87}); // movsd [rdi + disp32], xmm0
+  emit32(index * sizeof(double));
+}
+
+void Jit::loadConstant(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(double));
+  emit({0x48, 0xB8}); // mov rax, imm64
+  emit64(bits);
+  emit({0x66, 0x48, 0x0F, 0x6E, 0xC0}); // movq xmm0, rax
+}
+
+// Spills xmm0 while the right operand is computed
+void Jit::push() {
+  emit({0x48, 0x83, 0xEC, 0x08});       // sub rsp, 8
+  emit({0xF2, 0x0F, 0x11, 0x04, 0x24}); // movsd [rsp], xmm0
+}
+
+// Moves the right operand to xmm1 and restores the left one to xmm0
+void Jit::popRight() {
+  emit({0x66, 0x0F, 0x28, 0xC8});       // movapd xmm1, xmm0
+  emit({0xF2, 0x0F, 0x10, 0x04, 0x24}); // movsd xmm0, [rsp]
+  emit({0x48, 0x83, 0xC4, 0x08});       // add rsp, 8
+}
+
+// Emits a jump with a 32 bit displacement to be patched, returns where the
+// displacement is
+size_t Jit::jump(initializer_list<uint8_t> opcode) {
+  emit(opcode);
+  size_t at = code.size();
+  emit32(0);
+  return at;
+}
+
+void Jit::patch(size_t at) {
+  uint32_t offset = code.size() - (at + 4);
+  memcpy(&code[at], &offset, sizeof(uint32_t));
+}
+
+void Jit::jumpBack(size_t target) {
+  emit({0xE9}); // jmp
+  emit32(target - (code.size() + 4));
+}
+
+// ----------------------------------------
+// Expressions
+Obj Jit::visitExprAssign(Assign<Obj> *expr) {
+  compile(expr->value);
+  storeLocal(frameIndex(expr->depth, expr->slot));
+  return monostate();
+}
+
+Obj Jit::visitExprBinary(Binary<Obj> *expr) {
+  // Comparisons yield booleans, they are only compiled as conditions
+  TokenType op = expr->op.type;
+  if (op != PLUS && op != MINUS && op != STAR && op != SLASH)
+    throw Unsupported();
+
+  compile(expr->left);
+  push();
+  compile(expr->right);
+  popRight();
+
+  switch (op) {
+  case PLUS:
+    emit({0xF2, 0x0F, 0x58, 0xC1}); // addsd xmm0, xmm1
+    break;
+  case MINUS:
+    emit({0xF2, 0x0F, 0x5C, 0xC1}); // subsd xmm0, xmm1
+    break;
+  case STAR:
+    emit({0xF2, 0x0F, 0x59, 0xC1}); // mulsd xmm0, xmm1
+    break;
+  default:
+    emit({0xF2, 0x0F, 0x5E, 0xC1}); // divsd xmm0, xmm1
+    break;
+  }
+
+  return monostate();
+}
+
+Obj Jit::visitExprCall(Call<Obj> *) { throw Unsupported(); }
+
+Obj Jit::visitExprGrouping(Grouping<Obj> *expr) {
+  compile(expr->grouping);
+  return monostate();
+}
+
+Obj Jit::visitExprLiteral(Literal<Obj> *expr) {
+  if (!expr->value.isNumber())
+    throw Unsupported();
+
+  loadConstant(expr->value.asNumber());
+  return monostate();
+}
+
+Obj Jit::visitExprLogical(Logical<Obj> *) { throw Unsupported(); }
+
+Obj Jit::visitExprUnary(Unary<Obj> *expr) {
+  if (expr->op.type != MINUS)
+    throw Unsupported();
+
+  // Flip the sign bit, so -0 stays distinct from 0
+  compile(expr->right);
+  emit({0x48, 0xB8}); // mov rax, imm64
+  emit64(0x8000000000000000);
+  emit({0x66, 0x48, 0x0F, 0x6E, 0xC8}); // movq xmm1, rax
+  emit({0x66, 0x0F, 0x57, 0xC1});       // xorpd xmm0, xmm1
+  return monostate();
+}
+
+Obj Jit::visitExprVariable(Variable<Obj> *expr) {
+  loadLocal(frameIndex(expr->depth, expr->slot));
+  return monostate();
+}
+
+// ----------------------------------------
+// Statements
+Obj Jit::visitStmtBlock(Block<Obj> *stmt) {
+  scopes.push_back({});
+  compile(stmt->statements);
+  scopes.pop_back();
+  return monostate();
+}
+
+Obj Jit::visitStmtExpression(Expression<Obj> *stmt) {
+  compile(stmt->expr);
+  return monostate();
+}
+
+Obj Jit::visitStmtFunction(Function<Obj> *) { throw Unsupported(); }
+
+Obj Jit::visitStmtIf(If<Obj> *stmt) {
+  vector<size_t> falseJumps;
+  condition(stmt->condition, falseJumps);
+  compile(stmt->thenBranch);
+
+  if (!stmt->elseBranch) {
+    for (auto at : falseJumps)
+      patch(at);
+    return monostate();
+  }
+
+  size_t end = jump({0xE9}); // jmp
+  for (auto at : falseJumps)
+    patch(at);
+  compile(stmt->elseBranch);
+  patch(end);
+  return monostate();
+}
+
+Obj Jit::visitStmtPrint(Print<Obj> *) { throw Unsupported(); }
+
+Obj Jit::visitStmtReturn(Return<Obj> *stmt) {
+  if (!stmt->value) {
+    emit({0x31, 0xC0}); // xor eax, eax
+    emit({0xC3});       // ret
+    return monostate();
+  }
+
+  compile(stmt->value);
+  emit({0xF2, 0x0F, 0x11, 0x06});       // movsd [rsi], xmm0
+  emit({0xB8, 0x01, 0x00, 0x00, 0x00}); // mov eax, 1
+  emit({0xC3});                         // ret
+  return monostate();
+}
+
+Obj Jit::visitStmtVar(Var<Obj> *stmt) {
+  // An uninitialized local is nil, which compiled code can't hold
+  if (!stmt->initializer)
+    throw Unsupported();
+
+  compile(stmt->initializer);
+  storeLocal(declareLocal());
+  return monostate();
+}
+
+Obj Jit::visitStmtWhile(While<Obj> *stmt) {
+  size_t start = code.size();
+  vector<size_t> falseJumps;
+  condition(stmt->condition, falseJumps);
+  compile(stmt->body);
+  jumpBack(start);
+
+  for (auto at : falseJumps)
+    patch(at);
+  return monostate();
+}
+
+Jit &jit() {
+  static Jit instance;
+  return instance;
+}
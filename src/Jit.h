@@ -0,0 +1,85 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstdint>
+#include <list>
+#include <utility>
+#include <vector>
+
+#include "JitEntry.h"
+#include "Util.h"
+#include "gen/Expr.hpp"
+#include "gen/Stmt.hpp"
+
+using namespace std;
+
+// Most locals and parameters a compiled function may have
+#define JIT_MAX_LOCALS 256
+
+// Baseline template JIT for the tree Interpreter. Once a function has been
+// called threshold times its body is translated, node by node, to x86-64 code
+// in mmap'd memory. Only number arithmetic, comparisons in conditions,
+// locals, if, while and return are supported. Anything else, a call, a global
+// or a captured variable, leaves the function interpreted. Values are doubles
+// with an accumulator in xmm0 and temporaries spilled to the machine stack
+class Jit : ExprAstVisitor<Obj>, StmtAstVisitor<Obj> {
+public:
+  bool enabled = true;
+  // At least 1, calls are counted up to it
+  int threshold = 100;
+
+  ~Jit();
+  JitEntry compile(Function<Obj> *function);
+  bool run(JitEntry entry, const list<Obj> &arguments, Obj &result);
+  Obj visitExprAssign(Assign<Obj> *expr) override;
+  Obj visitExprBinary(Binary<Obj> *expr) override;
+  Obj visitExprCall(Call<Obj> *expr) override;
+  Obj visitExprGrouping(Grouping<Obj> *expr) override;
+  Obj visitExprLiteral(Literal<Obj> *expr) override;
+  Obj visitExprLogical(Logical<Obj> *expr) override;
+  Obj visitExprUnary(Unary<Obj> *expr) override;
+  Obj visitExprVariable(Variable<Obj> *expr) override;
+  Obj visitStmtBlock(Block<Obj> *stmt) override;
+  Obj visitStmtExpression(Expression<Obj> *stmt) override;
+  Obj visitStmtFunction(Function<Obj> *stmt) override;
+  Obj visitStmtIf(If<Obj> *stmt) override;
+  Obj visitStmtPrint(Print<Obj> *stmt) override;
+  Obj visitStmtReturn(Return<Obj> *stmt) override;
+  Obj visitStmtVar(Var<Obj> *stmt) override;
+  Obj visitStmtWhile(While<Obj> *stmt) override;
+
+private:
+  // Thrown when the function uses something the JIT can't compile
+  struct Unsupported {};
+
+  vector<uint8_t> code;
+  // Frame index of every slot, one vector per scope the Resolver numbered
+  vector<vector<int>> scopes;
+  int frameSize = 0;
+  // Executable regions handed out so far
+  vector<pair<void *, size_t>> regions;
+
+  void compile(const list<Stmt<Obj> *> &stmts);
+  void compile(Stmt<Obj> *stmt);
+  void compile(Expr<Obj> *expr);
+  void condition(Expr<Obj> *expr, vector<size_t> &falseJumps);
+  int frameIndex(int depth, int slot);
+  int declareLocal();
+  JitEntry install();
+
+  void emit(initializer_list<uint8_t> bytes);
+  void emit32(uint32_t value);
+  void emit64(uint64_t value);
+  void loadLocal(int index);
+  void storeLocal(int index);
+  void loadConstant(double value);
+  void push();
+  void popRight();
+  size_t jump(initializer_list<uint8_t> opcode);
+  void patch(size_t at);
+  void jumpBack(size_t target);
+};
+
+Jit &jit();
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef JIT_ENTRY_H
+#define JIT_ENTRY_H
+
+// Native code produced by the Jit for a Lox function. Arguments and locals
+// live in frame as doubles. A returned value is stored in result and
+// signalled by returning true, false means the body ran off its end and the
+// call evaluates to nil
+typedef bool (*JitEntry)(double *frame, double *result);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef LAZY_BODY_H
+#define LAZY_BODY_H
+
+#include <vector>
+
+#include "Arena.h"
+#include "Lex.h"
+
+using namespace std;
+
+// Function body skipped by the Parser's pre-parse. Begin is the token after
+// the opening brace, in tokens kept alive by the unit, and the body is parsed
+// into arena on the first call. A body that fails to parse is marked failed,
+// so its errors are reported once and later calls fail without parsing again
+struct LazyBody {
+  const vector<Token> *tokens;
+  Arena *arena;
+  int begin;
+  bool failed = false;
+};
+
+#endif
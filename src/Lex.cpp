@@ -1,98 +1,126 @@
 #include "Lex.h"
 
+#include <array>
+#include <charconv>
+#include <cstdint>
 #include <iostream>
 
+#include "Interner.h"
+
 #include "Util.h"
 
 typedef std::string string;
 
-std::map<TokenType, string> tok_to_string;
+// Names of the token types, in TokenType order
+static constexpr const char *tok_to_string[EOF_TOK + 1] = {
+    "LEFT_PAREN", "RIGHT_PAREN",   "LEFT_BRACE", "RIGHT_BRACE", "COMMA",
+    "DOT",        "MINUS",         "PLUS",       "SEMICOLON",   "SLASH",
+    "STAR",       "BANG",          "BANG_EQUAL", "EQUAL",       "EQUAL_EQUAL",
+    "GREATER",    "GREATER_EQUAL", "LESS",       "LESS_EQUAL",  "IDENTIFIER",
+    "STRING",     "NUMBER",        "AND",        "CLASS",       "ELSE",
+    "FALSE",      "FUN",           "FOR",        "IF",          "NIL",
+    "OR",         "PRINT",         "RETURN",     "SUPER",       "THIS",
+    "TRUE",       "VAR",           "WHILE",      "EOF_TOK"};
+
+// Character classes, one bit each in the table below
+enum CharClass : uint8_t { CHAR_DIGIT = 1, CHAR_ALPHA = 2 };
+
+static constexpr array<uint8_t, 256> charClassTable() {
+  array<uint8_t, 256> table{};
+  for (int c = '0'; c <= '9'; c++)
+    table[c] = CHAR_DIGIT;
+  for (int c = 'a'; c <= 'z'; c++)
+    table[c] = CHAR_ALPHA;
+  for (int c = 'A'; c <= 'Z'; c++)
+    table[c] = CHAR_ALPHA;
+  table['_'] = CHAR_ALPHA;
+  return table;
+}
+
+static constexpr array<uint8_t, 256> charClasses = charClassTable();
+
+static inline bool hasClass(char c, uint8_t mask) {
+  return charClasses[(unsigned char)c] & mask;
+}
+
+// Keyword for an identifier, or IDENTIFIER. The first character and the
+// length leave at most one candidate to compare against
+static TokenType keywordType(string_view text) {
+  auto is = [&](const char *keyword, TokenType type) {
+    return text == keyword ? type : IDENTIFIER;
+  };
+
+  switch (text[0]) {
+  case 'a':
+    return is("and", AND);
+  case 'c':
+    return is("class", CLASS);
+  case 'e':
+    return is("else", ELSE);
+  case 'f':
+    switch (text.size()) {
+    case 3:
+      return text[1] == 'u' ? is("fun", FUN) : is("for", FOR);
+    case 5:
+      return is("false", FALSE);
+    }
+    return IDENTIFIER;
+  case 'i':
+    return is("if", IF);
+  case 'n':
+    return is("nil", NIL);
+  case 'o':
+    return is("or", OR);
+  case 'p':
+    return is("print", PRINT);
+  case 'r':
+    return is("return", RETURN);
+  case 's':
+    return is("super", SUPER);
+  case 't':
+    switch (text.size()) {
+    case 4:
+      return text[1] == 'h' ? is("this", THIS) : is("true", TRUE);
+    }
+    return IDENTIFIER;
+  case 'v':
+    return is("var", VAR);
+  case 'w':
+    return is("while", WHILE);
+  }
+
+  return IDENTIFIER;
+}
 
 // ----------------------------------------
 // Token function definitions
-Token::Token(TokenType type, string lexeme, Obj literal, int line)
+Token::Token(TokenType type, string_view lexeme, Obj literal, int line)
     : type(type), lexeme(lexeme), literal(literal), line(line) {}
 
 string Token::show_val() {
-  return string("type: '" + tok_to_string[type] + "' lexeme: '" + lexeme +
-                "' literal: '" + to_string(literal) + "'");
+  return string("type: '") + tok_to_string[type] + "' lexeme: '" +
+         string(lexeme) + "' literal: '" + to_string(literal) + "'";
 }
 
 // ----------------------------------------
 // Lexer function definitions
-Lexer::Lexer(string src) : err(false), src(src), start(0), current(0), line(1) {
-  // Keywords for lox
-  keywords["and"] = AND;
-  keywords["class"] = CLASS;
-  keywords["else"] = ELSE;
-  keywords["false"] = FALSE;
-  keywords["for"] = FOR;
-  keywords["fun"] = FUN;
-  keywords["if"] = IF;
-  keywords["nil"] = NIL;
-  keywords["or"] = OR;
-  keywords["print"] = PRINT;
-  keywords["return"] = RETURN;
-  keywords["super"] = SUPER;
-  keywords["this"] = THIS;
-  keywords["true"] = TRUE;
-  keywords["var"] = VAR;
-  keywords["while"] = WHILE;
-
-  // Enum To string
-  tok_to_string[LEFT_PAREN] = "LEFT_PAREN";
-  tok_to_string[RIGHT_PAREN] = "RIGHT_PAREN";
-  tok_to_string[LEFT_BRACE] = "LEFT_BRACE";
-  tok_to_string[RIGHT_BRACE] = "RIGHT_BRACE";
-  tok_to_string[COMMA] = "COMMA";
-  tok_to_string[DOT] = "DOT";
-  tok_to_string[MINUS] = "MINUS";
-  tok_to_string[PLUS] = "PLUS";
-  tok_to_string[SEMICOLON] = "SEMICOLON";
-  tok_to_string[SLASH] = "SLASH";
-  tok_to_string[STAR] = "STAR";
-  tok_to_string[BANG] = "BANG";
-  tok_to_string[BANG_EQUAL] = "BANG_EQUAL";
-  tok_to_string[EQUAL] = "EQUAL";
-  tok_to_string[EQUAL_EQUAL] = "EQUAL_EQUAL";
-  tok_to_string[GREATER] = "GREATER";
-  tok_to_string[GREATER_EQUAL] = "GREATER_EQUAL";
-  tok_to_string[LESS] = "LESS";
-  tok_to_string[LESS_EQUAL] = "LESS_EQUAL";
-  tok_to_string[IDENTIFIER] = "IDENTIFIER";
-  tok_to_string[STRING] = "STRING";
-  tok_to_string[NUMBER] = "NUMBER";
-  tok_to_string[AND] = "AND";
-  tok_to_string[CLASS] = "CLASS";
-  tok_to_string[ELSE] = "ELSE";
-  tok_to_string[FALSE] = "FALSE";
-  tok_to_string[FUN] = "FUN";
-  tok_to_string[FOR] = "FOR";
-  tok_to_string[IF] = "IF";
-  tok_to_string[NIL] = "NIL";
-  tok_to_string[OR] = "OR";
-  tok_to_string[PRINT] = "PRINT";
-  tok_to_string[RETURN] = "RETURN";
-  tok_to_string[SUPER] = "SUPER";
-  tok_to_string[THIS] = "THIS";
-  tok_to_string[TRUE] = "TRUE";
-  tok_to_string[VAR] = "VAR";
-  tok_to_string[WHILE] = "WHILE";
-  tok_to_string[EOF_TOK] = "EOF_TOK";
-}
+Lexer::Lexer(string_view src)
+    : err(false), quiet(false), deferValues(false), src(src), start(0),
+      current(0), line(1), scan(scanKernels()) {}
 
 void Lexer::error(int line, string message) {
   err = true;
-  report(line, "", message);
+  if (!quiet)
+    report(line, "", message);
 }
 
-bool Lexer::isDigit(char c) { return c <= '9' && c >= '0'; }
+bool Lexer::isDigit(char c) { return hasClass(c, CHAR_DIGIT); }
 
-bool Lexer::isAlpha(char c) {
-  return (c <= 'z' && c >= 'a') || (c <= 'Z' && c >= 'A') || (c == '_');
-}
+bool Lexer::isAlpha(char c) { return hasClass(c, CHAR_ALPHA); }
 
-bool Lexer::isAlphaNumeric(char c) { return isAlpha(c) || isDigit(c); }
+bool Lexer::isAlphaNumeric(char c) {
+  return hasClass(c, CHAR_ALPHA | CHAR_DIGIT);
+}
 
 inline char Lexer::consume() { return src[current++]; }
 
@@ -118,38 +146,54 @@ bool Lexer::match(char expect) {
 
 void Lexer::addToken(TokenType type) { addToken(type, ""); }
 
-void Lexer::addToken(TokenType type, string literal) {
-  // Convert string to Obj variant
-  // Default is monostate
+void Lexer::addToken(TokenType type, string_view literal) {
+  // Convert the literal text to an Obj, default is nil
   Obj value;
+  double number;
 
-  switch (type) {
-  case STRING:
-    value = literal;
-    break;
-  case NUMBER:
-    value = stod(literal);
-    break;
-  default:
-    break;
+  if (type == NUMBER) {
+    from_chars(literal.data(), literal.data() + literal.size(), number);
+    value = number;
   }
 
   tokens.push_back(
       Token(type, src.substr(start, current - start), value, line));
+  if (!deferValues)
+    shareValue(tokens.back());
+}
+
+// Gives a string literal its value and an identifier its symbol
+void Lexer::shareValue(Token &token) {
+  if (token.type == STRING) {
+    // The AST and chunks refer to literals directly, out of the collector's
+    // sight
+    StringObj *text =
+        newString(token.lexeme.substr(1, token.lexeme.size() - 2));
+    text->pinned = true;
+    token.literal = text;
+  } else if (token.type == IDENTIFIER) {
+    token.symbol = interner().symbol(token.lexeme);
+  }
+}
+
+// Moves past the rest of a run of blanks. Single blanks between tokens are
+// common, so the kernel is only called when the run goes on
+void Lexer::skipBlanks() {
+  char next = lookahead(0);
+  if (next == ' ' || next == '\n')
+    current += scan.skipBlanks(src.data() + current, src.size() - current,
+                               line);
 }
 
 void Lexer::scanString() {
   // Consume chars until reach last '"'
-  while (lookahead(0) != '"' && !srcEnd()) {
-    if (lookahead(0) == '\n')
-      line++;
-
-    consume();
-  }
+  current += scan.findQuote(src.data() + current, src.size() - current, line);
 
   // If reach end, fail
   if (srcEnd()) {
     error(line, "Expect end of string");
+    if (quiet)
+      return;
     exit(1);
   }
 
@@ -211,9 +255,11 @@ void Lexer::consumeToken() {
     addToken(STAR);
     break;
   case ' ':
+    skipBlanks();
     break;
   case '\n':
     line++;
+    skipBlanks();
     break;
 
   // 2 char tokens
@@ -233,8 +279,7 @@ void Lexer::consumeToken() {
   // Slashes
   case '/':
     if (match('/'))
-      while (lookahead(0) != '\n' && !srcEnd())
-        consume();
+      current += scan.findNewline(src.data() + current, src.size() - current);
     else
       addToken(SLASH);
     break;
@@ -256,11 +301,8 @@ void Lexer::consumeToken() {
       scanIdentifier();
 
       // Check if it's a keyword
-      string identifierText = src.substr(start, current - start);
-      TokenType tokType = (keywords.find(identifierText) == keywords.end())
-                              ? IDENTIFIER
-                              : keywords[identifierText];
-      addToken(tokType, identifierText);
+      string_view identifierText = src.substr(start, current - start);
+      addToken(keywordType(identifierText), identifierText);
       // Error
     } else {
       error(line, string("Unexpected character: ") + c);
@@ -278,3 +320,33 @@ void Lexer::getTokens() {
 
   addToken(EOF_TOK);
 }
+
+// Lexes from begin up to the first token boundary at or after end, with no
+// EOF_TOK. Lines are counted from 1 at begin
+void Lexer::getTokens(uint begin, uint end) {
+  start = current = begin;
+  while (!srcEnd() && current < end) {
+    consumeToken();
+    start = current;
+  }
+}
+
+// Lexes just the next token, for a TokenStream. tokens only ever holds that
+// one, and at the end of the source every call returns EOF_TOK
+Token Lexer::nextToken() {
+  tokens.clear();
+  while (tokens.empty() && !srcEnd()) {
+    consumeToken();
+    start = current;
+  }
+
+  if (tokens.empty())
+    addToken(EOF_TOK);
+  return tokens.back();
+}
+
+// Where lexing stopped
+uint Lexer::position() { return current; }
+
+// Newlines passed so far
+uint Lexer::lines() { return line - 1; }
@@ -1,10 +1,11 @@
 #ifndef LEX_H
 #define LEX_H
 
-#include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "Scan.h"
 #include "Util.h"
 
 typedef std::string string;
@@ -59,14 +60,18 @@ enum TokenType {
   EOF_TOK
 };
 
+// Lexemes are views into the source buffer owned by the CompilationUnit, so
+// tokens are cheap to copy and never allocate
 class Token {
 public:
-  int line;
   TokenType type;
-  string lexeme;
+  string_view lexeme;
   Obj literal;
+  int line;
+  // Interned symbol id for identifiers, -1 for every other token
+  int symbol = -1;
 
-  Token(TokenType type, string lexeme, Obj literal, int line);
+  Token(TokenType type, string_view lexeme, Obj literal, int line);
   string show_val();
 };
 
@@ -74,12 +79,22 @@ class Lexer {
 public:
   std::vector<Token> tokens;
   bool err;
+  // Errors are only recorded in err, not reported, and do not exit
+  bool quiet;
+  // String literals and identifier symbols are left for shareValue, which
+  // touches the heap and the interner
+  bool deferValues;
 
-  Lexer(string src);
+  Lexer(string_view src);
+  static void shareValue(Token &token);
   bool isDigit(char c);
   bool isAlpha(char c);
   bool isAlphaNumeric(char c);
   void getTokens();
+  void getTokens(uint begin, uint end);
+  Token nextToken();
+  uint position();
+  uint lines();
   inline char consume();
   inline bool srcEnd();
   inline char lookahead(int offset);
@@ -89,13 +104,14 @@ public:
   void scanNum();
   void scanIdentifier();
   void addToken(TokenType type);
-  void addToken(TokenType type, string literal);
+  void addToken(TokenType type, string_view literal);
   void error(int line, string message);
 
 private:
-  string src;
+  string_view src;
   uint start, current, line;
-  std::map<string, TokenType> keywords;
+  const ScanKernels &scan;
+  void skipBlanks();
 };
 
 #endif
@@ -0,0 +1,19 @@
+#include "Object.h"
+
+#include "Callable.h"
+#include "Interner.h"
+
+using namespace std;
+
+StringObj *newString(string_view value) { return interner().intern(value); }
+
+Obj::Obj(Callable *callable) : Obj(static_cast<HeapObj *>(callable)) {}
+
+Callable *Obj::asCallable() const { return static_cast<Callable *>(asObj()); }
+
+bool Obj::operator==(const Obj &other) const {
+  if (isNumber() && other.isNumber())
+    return asNumber() == other.asNumber();
+
+  return bits == other.bits;
+}
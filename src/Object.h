@@ -0,0 +1,111 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <variant>
+
+using namespace std;
+
+class Callable;
+class Gc;
+
+enum HeapObjType { OBJ_STRING, OBJ_CALLABLE, OBJ_ENVIRONMENT, OBJ_UPVALUE };
+
+// Everything a value can point to lives behind a HeapObj, the value itself
+// only carries the pointer. HeapObjs are created through Gc::allocate, which
+// links them into the list the collector sweeps
+class HeapObj {
+public:
+  HeapObjType type;
+  bool marked = false;
+  // Pinned objects survive every collection, used for literals the AST and
+  // chunks refer to
+  bool pinned = false;
+  size_t size = 0;
+  HeapObj *next = nullptr;
+
+  HeapObj(HeapObjType type) : type(type) {}
+  virtual ~HeapObj() {}
+  // Marks every object this one refers to
+  virtual void trace(Gc &) {}
+};
+
+// Strings are interned, see Interner.h
+class StringObj : public HeapObj {
+public:
+  string value;
+  // Symbol id once the string has been used as a name, -1 before that
+  int symbol = -1;
+
+  StringObj(string value) : HeapObj(OBJ_STRING), value(value) {}
+};
+
+StringObj *newString(string_view value);
+
+// 8 byte NaN-boxed value. Numbers are stored as plain doubles, everything
+// else hides in the payload of a quiet NaN: nil and booleans as small tags,
+// heap objects as a pointer with the sign bit set
+class Obj {
+public:
+  Obj() : bits(QNAN | TAG_NIL) {}
+  Obj(monostate) : bits(QNAN | TAG_NIL) {}
+  Obj(bool value) : bits(QNAN | (value ? TAG_TRUE : TAG_FALSE)) {}
+  Obj(double value) { memcpy(&bits, &value, sizeof(double)); }
+  Obj(HeapObj *obj) : bits(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)obj) {}
+  Obj(Callable *callable);
+
+  // Literals must go through newString, not silently become a bool
+  Obj(const char *) = delete;
+
+  // Marks a global slot that was never defined, scripts can't produce it
+  static Obj undefined() {
+    Obj value;
+    value.bits = QNAN | TAG_UNDEFINED;
+    return value;
+  }
+
+  bool isNil() const { return bits == (QNAN | TAG_NIL); }
+  bool isUndefined() const { return bits == (QNAN | TAG_UNDEFINED); }
+  bool isBool() const { return (bits | 1) == (QNAN | TAG_TRUE); }
+  bool isNumber() const { return (bits & QNAN) != QNAN; }
+  bool isObj() const { return (bits & (SIGN_BIT | QNAN)) == (SIGN_BIT | QNAN); }
+  bool isString() const { return isObj() && asObj()->type == OBJ_STRING; }
+  bool isCallable() const { return isObj() && asObj()->type == OBJ_CALLABLE; }
+
+  bool asBool() const { return bits == (QNAN | TAG_TRUE); }
+  double asNumber() const {
+    double value;
+    memcpy(&value, &bits, sizeof(double));
+    return value;
+  }
+  HeapObj *asObj() const {
+    return (HeapObj *)(uintptr_t)(bits & ~(SIGN_BIT | QNAN));
+  }
+  StringObj *asString() const { return static_cast<StringObj *>(asObj()); }
+  Callable *asCallable() const;
+  // The boxed word itself. Equal bits means the same number, or the same
+  // object, which for interned strings means the same contents
+  uint64_t raw() const { return bits; }
+
+  // Same type and same value. Strings are interned, so equal contents means
+  // equal pointers
+  bool operator==(const Obj &other) const;
+  bool operator!=(const Obj &other) const { return !(*this == other); }
+
+private:
+  static const uint64_t SIGN_BIT = 0x8000000000000000;
+  static const uint64_t QNAN = 0x7ffc000000000000;
+  static const uint64_t TAG_NIL = 1;
+  static const uint64_t TAG_FALSE = 2;
+  static const uint64_t TAG_TRUE = 3;
+  static const uint64_t TAG_UNDEFINED = 4;
+
+  uint64_t bits;
+};
+
+static_assert(sizeof(Obj) == 8, "Obj must stay a single machine word");
+
+#endif
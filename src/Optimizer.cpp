@@ -0,0 +1,279 @@
+#include "Optimizer.h"
+
+using namespace std;
+
+Optimizer::Optimizer(Arena &arena)
+    : arena(arena), expression(nullptr), statement(nullptr) {}
+
+vector<Stmt<Obj> *> Optimizer::optimize(const vector<Stmt<Obj> *> &stmts) {
+  vector<Stmt<Obj> *> optimized;
+  for (auto stmt : stmts) {
+    Stmt<Obj> *result = optimize(stmt);
+    if (result)
+      optimized.push_back(result);
+  }
+
+  return optimized;
+}
+
+Expr<Obj> *Optimizer::optimize(Expr<Obj> *expr) {
+  expr->accept(this);
+  return expression;
+}
+
+Stmt<Obj> *Optimizer::optimize(Stmt<Obj> *stmt) {
+  stmt->accept(this);
+  return statement;
+}
+
+list<Stmt<Obj> *> Optimizer::optimize(const list<Stmt<Obj> *> &stmts) {
+  list<Stmt<Obj> *> optimized;
+  for (auto stmt : stmts) {
+    Stmt<Obj> *result = optimize(stmt);
+    if (result)
+      optimized.push_back(result);
+  }
+
+  return optimized;
+}
+
+// Stands in for a removed statement where the tree needs one, such as the
+// body of a loop
+Stmt<Obj> *Optimizer::emptyStatement() {
+  return new (arena) Block<Obj>(list<Stmt<Obj> *>());
+}
+
+// Folded strings are referenced by the AST only, so they are pinned like the
+// literals the Lexer produces
+Literal<Obj> *Optimizer::literal(Obj value) {
+  if (value.isObj())
+    value.asObj()->pinned = true;
+
+  return new (arena) Literal<Obj>(value);
+}
+
+Literal<Obj> *Optimizer::asLiteral(Expr<Obj> *expr) {
+  return dynamic_cast<Literal<Obj> *>(expr);
+}
+
+bool Optimizer::isTrue(Obj value) {
+  if (value.isNil())
+    return false;
+  else if (value.isBool())
+    return value.asBool();
+  else
+    return true;
+}
+
+// ----------------------------------------
+// Expressions
+Obj Optimizer::visitExprAssign(Assign<Obj> *expr) {
+  expr->value = optimize(expr->value);
+  expression = expr;
+  return monostate();
+}
+
+Obj Optimizer::visitExprBinary(Binary<Obj> *expr) {
+  expr->left = optimize(expr->left);
+  expr->right = optimize(expr->right);
+  expression = expr;
+
+  Literal<Obj> *left = asLiteral(expr->left);
+  Literal<Obj> *right = asLiteral(expr->right);
+  if (!left || !right)
+    return monostate();
+
+  Obj a = left->value;
+  Obj b = right->value;
+
+  switch (expr->op.type) {
+  case EQUAL_EQUAL:
+    expression = literal(a == b);
+    return monostate();
+  case BANG_EQUAL:
+    expression = literal(a != b);
+    return monostate();
+  case PLUS:
+    if (a.isString() && b.isString())
+      expression =
+          literal(newString(a.asString()->value + b.asString()->value));
+    break;
+  default:
+    break;
+  }
+
+  // The rest only folds when both sides are numbers, otherwise the runtime
+  // error is kept
+  if (!a.isNumber() || !b.isNumber())
+    return monostate();
+
+  double x = a.asNumber();
+  double y = b.asNumber();
+
+  switch (expr->op.type) {
+  case PLUS:
+    expression = literal(x + y);
+    break;
+  case MINUS:
+    expression = literal(x - y);
+    break;
+  case STAR:
+    expression = literal(x * y);
+    break;
+  case SLASH:
+    expression = literal(x / y);
+    break;
+  case GREATER:
+    expression = literal(x > y);
+    break;
+  case GREATER_EQUAL:
+    expression = literal(x >= y);
+    break;
+  case LESS:
+    expression = literal(x < y);
+    break;
+  case LESS_EQUAL:
+    expression = literal(x <= y);
+    break;
+  default:
+    break;
+  }
+
+  return monostate();
+}
+
+Obj Optimizer::visitExprCall(Call<Obj> *expr) {
+  expr->callee = optimize(expr->callee);
+  for (auto &arg : expr->arguments)
+    arg = optimize(arg);
+
+  expression = expr;
+  return monostate();
+}
+
+Obj Optimizer::visitExprGrouping(Grouping<Obj> *expr) {
+  // Parentheses only matter to the Parser, the tree already has the shape
+  expression = optimize(expr->grouping);
+  return monostate();
+}
+
+Obj Optimizer::visitExprLiteral(Literal<Obj> *expr) {
+  expression = expr;
+  return monostate();
+}
+
+Obj Optimizer::visitExprLogical(Logical<Obj> *expr) {
+  expr->left = optimize(expr->left);
+  expr->right = optimize(expr->right);
+  expression = expr;
+
+  Literal<Obj> *left = asLiteral(expr->left);
+  if (!left)
+    return monostate();
+
+  // A constant left side decides which operand the whole expression is
+  bool shortCircuits =
+      expr->op.type == OR ? isTrue(left->value) : !isTrue(left->value);
+  expression = shortCircuits ? expr->left : expr->right;
+  return monostate();
+}
+
+Obj Optimizer::visitExprUnary(Unary<Obj> *expr) {
+  expr->right = optimize(expr->right);
+  expression = expr;
+
+  Literal<Obj> *right = asLiteral(expr->right);
+  if (!right)
+    return monostate();
+
+  if (expr->op.type == BANG)
+    expression = literal(!isTrue(right->value));
+  else if (expr->op.type == MINUS && right->value.isNumber())
+    expression = literal(-right->value.asNumber());
+
+  return monostate();
+}
+
+Obj Optimizer::visitExprVariable(Variable<Obj> *expr) {
+  expression = expr;
+  return monostate();
+}
+
+// ----------------------------------------
+// Statements
+Obj Optimizer::visitStmtBlock(Block<Obj> *stmt) {
+  stmt->statements = optimize(stmt->statements);
+  statement = stmt;
+  return monostate();
+}
+
+Obj Optimizer::visitStmtExpression(Expression<Obj> *stmt) {
+  stmt->expr = optimize(stmt->expr);
+
+  // A bare constant has no effect
+  statement = asLiteral(stmt->expr) ? nullptr : stmt;
+  return monostate();
+}
+
+Obj Optimizer::visitStmtFunction(Function<Obj> *stmt) {
+  stmt->body = optimize(stmt->body);
+  statement = stmt;
+  return monostate();
+}
+
+Obj Optimizer::visitStmtIf(If<Obj> *stmt) {
+  stmt->condition = optimize(stmt->condition);
+  Stmt<Obj> *thenBranch = optimize(stmt->thenBranch);
+  Stmt<Obj> *elseBranch =
+      stmt->elseBranch ? optimize(stmt->elseBranch) : nullptr;
+
+  // Branches are statements, never declarations, so dropping one leaves the
+  // slots the Resolver handed out valid
+  Literal<Obj> *condition = asLiteral(stmt->condition);
+  if (condition) {
+    statement = isTrue(condition->value) ? thenBranch : elseBranch;
+    return monostate();
+  }
+
+  stmt->thenBranch = thenBranch ? thenBranch : emptyStatement();
+  stmt->elseBranch = elseBranch;
+  statement = stmt;
+  return monostate();
+}
+
+Obj Optimizer::visitStmtPrint(Print<Obj> *stmt) {
+  stmt->expr = optimize(stmt->expr);
+  statement = stmt;
+  return monostate();
+}
+
+Obj Optimizer::visitStmtReturn(Return<Obj> *stmt) {
+  if (stmt->value)
+    stmt->value = optimize(stmt->value);
+
+  statement = stmt;
+  return monostate();
+}
+
+Obj Optimizer::visitStmtVar(Var<Obj> *stmt) {
+  if (stmt->initializer)
+    stmt->initializer = optimize(stmt->initializer);
+
+  statement = stmt;
+  return monostate();
+}
+
+Obj Optimizer::visitStmtWhile(While<Obj> *stmt) {
+  stmt->condition = optimize(stmt->condition);
+  Stmt<Obj> *body = optimize(stmt->body);
+
+  Literal<Obj> *condition = asLiteral(stmt->condition);
+  if (condition && !isTrue(condition->value)) {
+    statement = nullptr;
+    return monostate();
+  }
+
+  stmt->body = body ? body : emptyStatement();
+  statement = stmt;
+  return monostate();
+}
@@ -0,0 +1,54 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <list>
+#include <vector>
+
+#include "Arena.h"
+#include "Util.h"
+#include "gen/Expr.hpp"
+#include "gen/Stmt.hpp"
+
+using namespace std;
+
+// Optional pass (-O) run between the Resolver and the engines. Constant
+// Binary, Unary and Logical subtrees become a single Literal, Groupings
+// disappear and branches that can never run are dropped. Anything that would
+// fail at runtime is left alone, so errors still surface where they did
+class Optimizer : ExprAstVisitor<Obj>, StmtAstVisitor<Obj> {
+public:
+  Optimizer(Arena &arena);
+  vector<Stmt<Obj> *> optimize(const vector<Stmt<Obj> *> &stmts);
+  Obj visitExprAssign(Assign<Obj> *expr) override;
+  Obj visitExprBinary(Binary<Obj> *expr) override;
+  Obj visitExprCall(Call<Obj> *expr) override;
+  Obj visitExprGrouping(Grouping<Obj> *expr) override;
+  Obj visitExprLiteral(Literal<Obj> *expr) override;
+  Obj visitExprLogical(Logical<Obj> *expr) override;
+  Obj visitExprUnary(Unary<Obj> *expr) override;
+  Obj visitExprVariable(Variable<Obj> *expr) override;
+  Obj visitStmtBlock(Block<Obj> *stmt) override;
+  Obj visitStmtExpression(Expression<Obj> *stmt) override;
+  Obj visitStmtFunction(Function<Obj> *stmt) override;
+  Obj visitStmtIf(If<Obj> *stmt) override;
+  Obj visitStmtPrint(Print<Obj> *stmt) override;
+  Obj visitStmtReturn(Return<Obj> *stmt) override;
+  Obj visitStmtVar(Var<Obj> *stmt) override;
+  Obj visitStmtWhile(While<Obj> *stmt) override;
+
+private:
+  Arena &arena;
+  // Node that replaces the one just visited, a null statement was removed
+  Expr<Obj> *expression;
+  Stmt<Obj> *statement;
+
+  Expr<Obj> *optimize(Expr<Obj> *expr);
+  Stmt<Obj> *optimize(Stmt<Obj> *stmt);
+  list<Stmt<Obj> *> optimize(const list<Stmt<Obj> *> &stmts);
+  Stmt<Obj> *emptyStatement();
+  Literal<Obj> *literal(Obj value);
+  Literal<Obj> *asLiteral(Expr<Obj> *expr);
+  bool isTrue(Obj value);
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Runs task(index, worker) for every index below count on up to jobs threads,
+// the calling one included. Threads take the next index when they finish one,
+// and worker numbers them from 0, so per-thread state can be kept in a vector
+template <typename Task> void parallelFor(int jobs, int count, Task task) {
+  int workers = max(1, min(jobs, count));
+  atomic<int> next(0);
+
+  auto work = [&](int worker) {
+    for (int index = next++; index < count; index = next++)
+      task(index, worker);
+  };
+
+  vector<thread> pool;
+  for (int worker = 1; worker < workers; worker++)
+    pool.emplace_back(work, worker);
+  work(0);
+  for (auto &thread : pool)
+    thread.join();
+}
+
+#endif
@@ -0,0 +1,110 @@
+#include "ParallelLexer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Parallel.h"
+
+using namespace std;
+
+// Chunks smaller than this are not worth handing to another thread
+#define MIN_CHUNK_BYTES (1024 * 1024)
+// Chunks made per thread, so threads that finish early pick up more work
+#define CHUNKS_PER_JOB 4
+
+ParallelLexer::ParallelLexer(string_view src, int jobs)
+    : err(false), src(src), jobs(jobs) {}
+
+void ParallelLexer::getTokens() {
+  size_t wanted = min<size_t>((size_t)jobs * CHUNKS_PER_JOB,
+                              src.size() / MIN_CHUNK_BYTES);
+  vector<uint> bounds = split(wanted);
+  int count = bounds.size() - 1;
+  if (jobs < 2 || count < 2) {
+    getTokensSequential();
+    return;
+  }
+
+  vector<Chunk> chunks(count);
+  parallelFor(jobs, count, [&](int index, int) {
+    Chunk &chunk = chunks[index];
+    chunk.begin = bounds[index];
+    chunk.end = bounds[index + 1];
+    lex(chunk, chunk.begin);
+  });
+
+  // Repair the chunks that did not start where the previous one stopped
+  uint expected = 0;
+  for (auto &chunk : chunks) {
+    if (chunk.begin != expected)
+      lex(chunk, expected);
+    if (chunk.err) {
+      getTokensSequential();
+      return;
+    }
+    expected = chunk.exit;
+  }
+
+  size_t total = 1;
+  for (auto &chunk : chunks)
+    total += chunk.tokens.size();
+  tokens.reserve(total);
+
+  uint base = 0;
+  for (auto &chunk : chunks) {
+    for (auto &token : chunk.tokens) {
+      token.line += base;
+      Lexer::shareValue(token);
+      tokens.push_back(token);
+    }
+    base += chunk.lines;
+  }
+
+  tokens.push_back(Token(EOF_TOK, src.substr(src.size()), monostate(),
+                         base + 1));
+}
+
+// Start of every chunk plus the end of the source. Chunks start on a line
+// that does not begin with a blank, so no run of blanks spans two of them
+vector<uint> ParallelLexer::split(int chunks) {
+  vector<uint> bounds = {0};
+
+  for (int i = 1; i < chunks; i++) {
+    size_t cut = max<size_t>(src.size() / chunks * i, bounds.back());
+    const char *newline = static_cast<const char *>(
+        memchr(src.data() + cut, '\n', src.size() - cut));
+    if (newline == nullptr)
+      break;
+
+    cut = newline - src.data() + 1;
+    while (cut < src.size() && (src[cut] == ' ' || src[cut] == '\n'))
+      cut++;
+    if (cut >= src.size())
+      break;
+    bounds.push_back(cut);
+  }
+
+  bounds.push_back(src.size());
+  return bounds;
+}
+
+// Lexes the chunk starting at begin, which may already be past its end when
+// the previous chunk swallowed it
+void ParallelLexer::lex(Chunk &chunk, uint begin) {
+  Lexer lexer(src);
+  lexer.quiet = true;
+  lexer.deferValues = true;
+  lexer.getTokens(begin, chunk.end);
+
+  chunk.tokens = std::move(lexer.tokens);
+  chunk.exit = max(begin, lexer.position());
+  chunk.lines = lexer.lines();
+  chunk.err = lexer.err;
+}
+
+void ParallelLexer::getTokensSequential() {
+  Lexer lexer(src);
+  lexer.getTokens();
+  tokens = std::move(lexer.tokens);
+  err = lexer.err;
+}
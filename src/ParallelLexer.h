@@ -0,0 +1,44 @@
+#ifndef PARALLEL_LEXER_H
+#define PARALLEL_LEXER_H
+
+#include <string_view>
+#include <vector>
+
+#include "Lex.h"
+
+using namespace std;
+
+// Lexes a large source on several threads, producing exactly the tokens of
+// the sequential Lexer. The source is cut at line starts and every chunk is
+// lexed speculatively, as if it started between tokens. Only a string
+// literal can span lines, so a chunk is wrong only when the previous one ran
+// past its end inside a string. Such chunks are lexed again from where the
+// previous one stopped. Lines are then made absolute, string values and
+// symbols created in source order, and any error has the whole source lexed
+// again sequentially so it is reported the same way
+class ParallelLexer {
+public:
+  vector<Token> tokens;
+  bool err;
+
+  ParallelLexer(string_view src, int jobs);
+  void getTokens();
+
+private:
+  struct Chunk {
+    uint begin, end;
+    vector<Token> tokens;
+    // Where lexing stopped and the newlines passed until then
+    uint exit, lines;
+    bool err;
+  };
+
+  string_view src;
+  int jobs;
+
+  vector<uint> split(int chunks);
+  void lex(Chunk &chunk, uint begin);
+  void getTokensSequential();
+};
+
+#endif
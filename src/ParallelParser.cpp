@@ -0,0 +1,120 @@
+#include "ParallelParser.h"
+
+#include <algorithm>
+
+#include "Parallel.h"
+#include "Parser.h"
+
+using namespace std;
+
+// Chunks smaller than this are not worth handing to another thread
+#define MIN_CHUNK_TOKENS 16384
+// Chunks made per thread, so threads that finish early pick up more work
+#define CHUNKS_PER_JOB 4
+
+ParallelParser::ParallelParser(CompilationUnit &unit, int jobs)
+    : err(false), lazy(false), unit(unit), jobs(jobs) {}
+
+vector<Stmt<Obj> *> ParallelParser::parse() {
+  const vector<Token> &tokens = unit.tokens;
+  size_t wanted = min<size_t>((size_t)jobs * CHUNKS_PER_JOB,
+                              tokens.size() / MIN_CHUNK_TOKENS);
+  vector<int> bounds = split(wanted);
+  int chunks = bounds.size() - 1;
+  if (jobs < 2 || chunks < 2)
+    return parseSequential();
+
+  // One arena per thread, the Arena is not safe to share
+  int threads = min(jobs, chunks);
+  vector<Arena *> arenas;
+  for (int i = 0; i < threads; i++) {
+    unit.chunkArenas.emplace_back();
+    arenas.push_back(&unit.chunkArenas.back());
+  }
+
+  vector<vector<Stmt<Obj> *>> results(chunks);
+  vector<char> failed(chunks, false);
+
+  parallelFor(threads, chunks, [&](int chunk, int worker) {
+    Parser<Obj> parser(tokens, *arenas[worker]);
+    parser.lazy = lazy;
+    parser.quiet = true;
+    results[chunk] = parser.parse(bounds[chunk], bounds[chunk + 1]);
+    failed[chunk] = parser.err;
+  });
+
+  if (find(failed.begin(), failed.end(), true) != failed.end()) {
+    unit.chunkArenas.clear();
+    return parseSequential();
+  }
+
+  size_t total = 0;
+  for (auto &result : results)
+    total += result.size();
+
+  vector<Stmt<Obj> *> statements;
+  statements.reserve(total);
+  for (auto &result : results)
+    statements.insert(statements.end(), result.begin(), result.end());
+
+  return statements;
+}
+
+// Start of every chunk, plus the index of the final EOF_TOK. Cuts are only
+// made outside any brace or parenthesis, where a complete statement ended
+vector<int> ParallelParser::split(int chunks) {
+  const vector<Token> &tokens = unit.tokens;
+  int last = tokens.size() - 1;
+  vector<int> bounds = {0};
+
+  if (chunks > 1) {
+    int size = last / chunks;
+    int braces = 0, parens = 0;
+
+    // Unbalanced input is left to a single chunk from there on
+    for (int i = 0; i < last && braces >= 0 && parens >= 0; i++) {
+      if (i >= bounds.back() + size && braces == 0 && parens == 0 &&
+          isBoundary(i))
+        bounds.push_back(i);
+
+      switch (tokens[i].type) {
+      case LEFT_BRACE:
+        braces++;
+        break;
+      case RIGHT_BRACE:
+        braces--;
+        break;
+      case LEFT_PAREN:
+        parens++;
+        break;
+      case RIGHT_PAREN:
+        parens--;
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  bounds.push_back(last);
+  return bounds;
+}
+
+// A fun or var right after the end of the previous statement
+bool ParallelParser::isBoundary(int index) {
+  const vector<Token> &tokens = unit.tokens;
+  TokenType type = tokens[index].type;
+  if (index == 0 || (type != FUN && type != VAR))
+    return false;
+
+  TokenType previous = tokens[index - 1].type;
+  return previous == SEMICOLON || previous == RIGHT_BRACE;
+}
+
+vector<Stmt<Obj> *> ParallelParser::parseSequential() {
+  Parser<Obj> parser(unit.tokens, unit.arena);
+  parser.lazy = lazy;
+  vector<Stmt<Obj> *> statements = parser.parse();
+  err = parser.err;
+  return statements;
+}
@@ -0,0 +1,34 @@
+#ifndef PARALLEL_PARSER_H
+#define PARALLEL_PARSER_H
+
+#include <vector>
+
+#include "CompilationUnit.h"
+#include "Lex.h"
+#include "gen/Stmt.hpp"
+
+using namespace std;
+
+// Parses the top-level declarations of a unit on several threads. The tokens
+// are cut where a top-level fun or var declaration starts, each chunk is
+// parsed by its own Parser into an arena of its thread and the statements are
+// stitched back in source order. When any chunk has an error the whole unit is
+// parsed again sequentially, so errors are reported exactly as without threads
+class ParallelParser {
+public:
+  bool err;
+  bool lazy;
+
+  ParallelParser(CompilationUnit &unit, int jobs);
+  vector<Stmt<Obj> *> parse();
+
+private:
+  CompilationUnit &unit;
+  int jobs;
+
+  vector<int> split(int chunks);
+  bool isBoundary(int index);
+  vector<Stmt<Obj> *> parseSequential();
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "Parser.h"
 
+#include <array>
 #include <iostream>
 #include <vector>
 
@@ -8,28 +9,71 @@
 
 using namespace std;
 
+// Precedence of each token used as a binary operator, PREC_NONE for the rest.
+// BANG is accepted between operands like the other equality operators
+static constexpr array<Precedence, EOF_TOK + 1> precedenceTable() {
+  array<Precedence, EOF_TOK + 1> table{};
+  table[OR] = PREC_OR;
+  table[AND] = PREC_AND;
+  table[BANG] = PREC_EQUALITY;
+  table[BANG_EQUAL] = PREC_EQUALITY;
+  table[EQUAL_EQUAL] = PREC_EQUALITY;
+  table[GREATER] = PREC_COMPARISON;
+  table[GREATER_EQUAL] = PREC_COMPARISON;
+  table[LESS] = PREC_COMPARISON;
+  table[LESS_EQUAL] = PREC_COMPARISON;
+  table[MINUS] = PREC_TERM;
+  table[PLUS] = PREC_TERM;
+  table[SLASH] = PREC_FACTOR;
+  table[STAR] = PREC_FACTOR;
+  return table;
+}
+
+static constexpr array<Precedence, EOF_TOK + 1> precedences =
+    precedenceTable();
+
 // Aux functions
 template <typename T>
-Parser<T>::Parser(vector<Token> tokens)
-    : err(false), tokens(tokens), current(0) {}
+Parser<T>::Parser(const vector<Token> &tokens, Arena &arena)
+    : err(false), lazy(false), quiet(false), tokens(tokens), stream(nullptr),
+      arena(arena), current(0), end(tokens.size() - 1), depth(0) {}
+
+// Without a token vector, tokens are pulled from the stream. Lazy bodies and
+// ranges need the vector and are not available
+static const vector<Token> noTokens;
+
+template <typename T>
+Parser<T>::Parser(TokenStream &stream, Arena &arena)
+    : err(false), lazy(false), quiet(false), tokens(noTokens), stream(&stream),
+      arena(arena), current(0), end(0), depth(0) {}
 
 template <typename T> bool Parser<T>::isEnd() {
   return lookahead().type == EOF_TOK;
 }
 
-template <typename T> Token Parser<T>::lookahead() { return tokens[current]; }
+template <typename T> const Token &Parser<T>::lookahead() {
+  if (stream)
+    return stream->peek();
+  return current < end ? tokens[current] : tokens.back();
+}
 
-template <typename T> Token Parser<T>::getPrevious() {
+template <typename T> const Token &Parser<T>::getPrevious() {
+  if (stream)
+    return stream->previous();
   return tokens[current - 1];
 }
 
-template <typename T> Token Parser<T>::consume() {
-  if (!isEnd())
+template <typename T> const Token &Parser<T>::consume() {
+  if (!isEnd()) {
+    if (stream)
+      stream->advance();
     current++;
+  }
   return getPrevious();
 }
 
-template <typename T> Token Parser<T>::consume(TokenType type, string message) {
+template <typename T>
+const Token &Parser<T>::consume(TokenType type, string message) {
   if (check(type))
     return consume();
 
@@ -43,7 +87,8 @@ template <typename T> bool Parser<T>::check(TokenType val) {
   return lookahead().type == val;
 }
 
-template <typename T> bool Parser<T>::match(vector<TokenType> types) {
+template <typename T>
+bool Parser<T>::match(initializer_list<TokenType> types) {
   for (auto type : types) {
     if (check(type)) {
       consume();
@@ -54,12 +99,15 @@ template <typename T> bool Parser<T>::match(vector<TokenType> types) {
 }
 
 template <typename T>
-ParserError Parser<T>::error(Token token, string message) {
+ParserError Parser<T>::error(const Token &token, string message) {
   err = true;
+  if (quiet)
+    return ParserError();
+
   if (token.type == EOF_TOK)
     report(token.line, " at end", message);
   else
-    report(token.line, " at '" + token.lexeme + "'", message);
+    report(token.line, " at '" + string(token.lexeme) + "'", message);
   return ParserError();
 }
 
@@ -102,10 +150,31 @@ template <typename T> vector<Stmt<T> *> Parser<T>::parse() {
   }
 }
 
+// Parses a body skipped by the pre-parse, errors are reported as usual
+template <typename T>
+list<Stmt<T> *> Parser<T>::parseBody(const LazyBody &body) {
+  current = body.begin;
+  depth = 1;
+
+  try {
+    return block();
+  } catch (const ParserError &err) {
+    return list<Stmt<T> *>();
+  }
+}
+
+// Parses the declarations in tokens [begin, end), as if they were all there is
+template <typename T>
+vector<Stmt<T> *> Parser<T>::parse(int begin, int end) {
+  current = begin;
+  this->end = end;
+  return parse();
+}
+
 template <typename T> Expr<T> *Parser<T>::expression() { return assignment(); }
 
 template <typename T> Expr<T> *Parser<T>::assignment() {
-  Expr<T> *expr = orOp();
+  Expr<T> *expr = binary(PREC_OR);
 
   if (match({EQUAL})) {
     Token equals = getPrevious();
@@ -114,7 +183,7 @@ template <typename T> Expr<T> *Parser<T>::assignment() {
     auto *variable = dynamic_cast<Variable<T> *>(expr);
     if (variable) {
       Token name = variable->name;
-      return new Assign<T>(name, value);
+      return new (arena) Assign<T>(name, value);
     }
 
     error(equals, "Invalid assignment target.");
@@ -123,78 +192,26 @@ template <typename T> Expr<T> *Parser<T>::assignment() {
   return expr;
 }
 
-template <typename T> Expr<T> *Parser<T>::orOp() {
-  Expr<T> *expr = andOp();
-
-  while (match({OR})) {
-    Token op = getPrevious();
-    Expr<T> *right = andOp();
-
-    expr = new Logical<T>(expr, op, right);
-  }
-
-  return expr;
-}
-
-template <typename T> Expr<T> *Parser<T>::andOp() {
-  Expr<T> *expr = equality();
-
-  while (match({OR})) {
-    Token op = getPrevious();
-    Expr<T> *right = equality();
-
-    expr = new Logical<T>(expr, op, right);
-  }
-
-  return expr;
-}
-
-template <typename T> Expr<T> *Parser<T>::equality() {
-  Expr<T> *expr = comparison();
-
-  while (match({BANG, BANG_EQUAL, EQUAL_EQUAL})) {
-    auto op = getPrevious();
-    Expr<T> *right = comparison();
-
-    expr = new Binary<T>(expr, op, right);
-  }
-  return expr;
-}
-
-template <typename T> Expr<T> *Parser<T>::comparison() {
-  Expr<T> *expr = term();
-
-  while (match({GREATER, GREATER_EQUAL, LESS, LESS_EQUAL})) {
-    auto op = getPrevious();
-    Expr<T> *right = term();
-
-    expr = new Binary<T>(expr, op, right);
-  }
-  return expr;
-}
-
-template <typename T> Expr<T> *Parser<T>::term() {
-  Expr<T> *expr = factor();
-
-  while (match({MINUS, PLUS})) {
-    auto op = getPrevious();
-    Expr<T> *right = factor();
-
-    expr = new Binary<T>(expr, op, right);
-  }
-  return expr;
-}
-
-template <typename T> Expr<T> *Parser<T>::factor() {
+// Operator-precedence parsing of every binary and logical operator that binds
+// at least as tight as minimum. All of them are left associative, so the right
+// operand only takes operators binding tighter than the current one
+template <typename T> Expr<T> *Parser<T>::binary(Precedence minimum) {
   Expr<T> *expr = unary();
 
-  while (match({SLASH, STAR})) {
-    auto op = getPrevious();
-    Expr<T> *right = unary();
+  for (;;) {
+    Precedence precedence = precedences[lookahead().type];
+    if (precedence == PREC_NONE || precedence < minimum)
+      return expr;
+
+    // A copy, parsing the right operand moves a TokenStream past it
+    Token op = consume();
+    Expr<T> *right = binary(Precedence(precedence + 1));
 
-    expr = new Binary<T>(expr, op, right);
+    if (op.type == AND || op.type == OR)
+      expr = new (arena) Logical<T>(expr, op, right);
+    else
+      expr = new (arena) Binary<T>(expr, op, right);
   }
-  return expr;
 }
 
 template <typename T> Expr<T> *Parser<T>::unary() {
@@ -202,7 +219,7 @@ template <typename T> Expr<T> *Parser<T>::unary() {
     auto op = getPrevious();
     Expr<T> *expr = unary();
 
-    expr = new Unary<T>(op, expr);
+    expr = new (arena) Unary<T>(op, expr);
     return expr;
   }
 
@@ -235,25 +252,25 @@ template <typename T> Expr<T> *Parser<T>::finishCall(Expr<T> *callee) {
 
   Token paren = consume(RIGHT_PAREN, "Expected ')' after arguments.");
 
-  return new Call<T>(callee, paren, arguments);
+  return new (arena) Call<T>(callee, paren, arguments);
 }
 
 template <typename T> Expr<T> *Parser<T>::primary() {
   if (match({FALSE}))
-    return new Literal<T>("false");
+    return new (arena) Literal<T>(false);
   else if (match({TRUE}))
-    return new Literal<T>("true");
+    return new (arena) Literal<T>(true);
   else if (match({NIL}))
-    return new Literal<T>("nil");
+    return new (arena) Literal<T>(monostate());
   else if (match({NUMBER, STRING}))
-    return new Literal<T>(getPrevious().literal);
+    return new (arena) Literal<T>(getPrevious().literal);
   else if (match({IDENTIFIER}))
-    return new Variable<T>(getPrevious());
+    return new (arena) Variable<T>(getPrevious());
   else if (match({LEFT_PAREN})) {
     Expr<T> *expr = expression();
 
     consume(RIGHT_PAREN, "Expected ')' after expression");
-    return new Grouping<T>(expr);
+    return new (arena) Grouping<T>(expr);
   } else {
     throw error(lookahead(), "Expected expression");
     err = true;
@@ -269,16 +286,16 @@ template <typename T> Stmt<T> *Parser<T>::declaration() {
       return varDeclaration();
     return statement();
   } catch (ParserError error) {
-    // sync();
+    synchronize();
     return nullptr;
   }
 }
 
 template <typename T> Stmt<T> *Parser<T>::function(string kind) {
   Token name =
-      consume(IDENTIFIER, to_string("Expect ") + kind + to_string(" name."));
+      consume(IDENTIFIER, string("Expect ") + kind + string(" name."));
   consume(LEFT_PAREN,
-          to_string("Expect '(' after ") + kind + to_string(" name."));
+          string("Expect '(' after ") + kind + string(" name."));
 
   list<Token> parameters;
   if (!check(RIGHT_PAREN)) {
@@ -292,10 +309,17 @@ template <typename T> Stmt<T> *Parser<T>::function(string kind) {
 
   consume(RIGHT_PAREN, "Expect ')' after parameters.");
   consume(LEFT_BRACE,
-          to_string("Expect '{' before ") + kind + to_string(" body."));
+          string("Expect '{' before ") + kind + string(" body."));
+
+  // Only top-level bodies are deferred, they resolve against globals alone
+  if (lazy && depth == 0) {
+    auto function = new (arena) Function<T>(name, parameters, {});
+    function->lazy = skipBody();
+    return function;
+  }
 
   list<Stmt<T> *> body = block();
-  return new Function<T>(name, parameters, body);
+  return new (arena) Function<T>(name, parameters, body);
 }
 
 template <typename T> Stmt<T> *Parser<T>::varDeclaration() {
@@ -307,7 +331,7 @@ template <typename T> Stmt<T> *Parser<T>::varDeclaration() {
   }
 
   consume(SEMICOLON, "Expect ';' after variable declaration");
-  return new Var<T>(name, initializer);
+  return new (arena) Var<T>(name, initializer);
 }
 
 template <typename T> Stmt<T> *Parser<T>::whileStatement() {
@@ -316,7 +340,7 @@ template <typename T> Stmt<T> *Parser<T>::whileStatement() {
   consume(RIGHT_PAREN, "Expect ')' after 'while' condition.");
 
   Stmt<T> *body = statement();
-  return new While(condition, body);
+  return new (arena) While<T>(condition, body);
 }
 
 template <typename T> Stmt<T> *Parser<T>::statement() {
@@ -331,7 +355,7 @@ template <typename T> Stmt<T> *Parser<T>::statement() {
   if (match({WHILE}))
     return whileStatement();
   if (match({LEFT_BRACE}))
-    return new Block(block());
+    return new (arena) Block<T>(block());
 
   return expressionStatement();
 }
@@ -362,14 +386,15 @@ template <typename T> Stmt<T> *Parser<T>::forStatement() {
   Stmt<T> *body = statement();
 
   if (increment != nullptr)
-    body = new Block<T>({body, new Expression<T>(increment)});
+    body = new (arena)
+        Block<T>({body, new (arena) Expression<T>(increment)});
 
   if (condition == nullptr)
-    condition = new Literal<T>(true);
-  body = new While<T>(condition, body);
+    condition = new (arena) Literal<T>(true);
+  body = new (arena) While<T>(condition, body);
 
   if (initializer != nullptr)
-    body = new Block<T>({initializer, body});
+    body = new (arena) Block<T>({initializer, body});
 
   return body;
 }
@@ -385,14 +410,14 @@ template <typename T> Stmt<T> *Parser<T>::ifStatement() {
   if (match({ELSE}))
     elseBranch = statement();
 
-  return new If<T>(condition, thenBranch, elseBranch);
+  return new (arena) If<T>(condition, thenBranch, elseBranch);
 }
 
 template <typename T> Stmt<T> *Parser<T>::printStatement() {
   Expr<T> *value = expression();
   consume(SEMICOLON, "Expected ';' after expression");
 
-  return new Print<T>(value);
+  return new (arena) Print<T>(value);
 }
 
 template <typename T> Stmt<T> *Parser<T>::returnStatement() {
@@ -402,25 +427,46 @@ template <typename T> Stmt<T> *Parser<T>::returnStatement() {
     value = expression();
 
   consume(SEMICOLON, "Expected ';' after return value");
-  return new Return<T>(keyword, value);
+  return new (arena) Return<T>(keyword, value);
 }
 
 template <typename T> list<Stmt<T> *> Parser<T>::block() {
   list<Stmt<T> *> stmts;
 
-  while (!check(RIGHT_BRACE)) {
+  depth++;
+  while (!check(RIGHT_BRACE) && !isEnd()) {
     stmts.push_back(declaration());
   }
+  depth--;
 
   consume(RIGHT_BRACE, "Expect '}' after block.");
   return stmts;
 }
 
+// Moves past the closing brace of the body starting at the current token
+template <typename T> LazyBody *Parser<T>::skipBody() {
+  int begin = current;
+
+  for (int open = 1; open > 0;) {
+    if (isEnd())
+      throw error(lookahead(), "Expect '}' after block.");
+
+    TokenType type = consume().type;
+    if (type == LEFT_BRACE)
+      open++;
+    else if (type == RIGHT_BRACE)
+      open--;
+  }
+
+  void *memory = arena.allocate(sizeof(LazyBody));
+  return new (memory) LazyBody{&tokens, &arena, begin};
+}
+
 template <typename T> Stmt<T> *Parser<T>::expressionStatement() {
   Expr<T> *value = expression();
   consume(SEMICOLON, "Expected ';' after value");
 
-  return new Expression<T>(value);
+  return new (arena) Expression<T>(value);
 }
 
 template class Parser<string>;
@@ -1,12 +1,15 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <initializer_list>
 #include <list>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "Arena.h"
 #include "Lex.h"
+#include "TokenStream.h"
 #include "gen/Expr.hpp"
 #include "gen/Stmt.hpp"
 
@@ -17,29 +20,42 @@ public:
   ParserError() : runtime_error("") {}
 };
 
+// Binding power of binary and logical operators, tightest last
+enum Precedence {
+  PREC_NONE,
+  PREC_OR,
+  PREC_AND,
+  PREC_EQUALITY,
+  PREC_COMPARISON,
+  PREC_TERM,
+  PREC_FACTOR
+};
+
 template <typename T> class Parser {
 public:
   bool err;
+  // Pre-parse mode, top-level function bodies are only brace-matched
+  bool lazy;
+  // Errors are only recorded in err, not reported
+  bool quiet;
 
-  Parser(vector<Token> tokens);
+  Parser(const vector<Token> &tokens, Arena &arena);
+  Parser(TokenStream &stream, Arena &arena);
   bool isEnd();
-  Token lookahead();
-  Token getPrevious();
-  Token consume();
-  Token consume(TokenType type, string message);
+  const Token &lookahead();
+  const Token &getPrevious();
+  const Token &consume();
+  const Token &consume(TokenType type, string message);
   bool check(TokenType val);
-  bool match(vector<TokenType> types);
-  ParserError error(Token token, string message);
+  bool match(initializer_list<TokenType> types);
+  ParserError error(const Token &token, string message);
   void synchronize();
   vector<Stmt<T> *> parse();
+  vector<Stmt<T> *> parse(int begin, int end);
+  list<Stmt<T> *> parseBody(const LazyBody &body);
   Expr<T> *assignment();
   Expr<T> *expression();
-  Expr<T> *orOp();
-  Expr<T> *andOp();
-  Expr<T> *equality();
-  Expr<T> *comparison();
-  Expr<T> *term();
-  Expr<T> *factor();
+  Expr<T> *binary(Precedence minimum);
   Expr<T> *unary();
   Expr<T> *call();
   Expr<T> *finishCall(Expr<T> *callee);
@@ -55,11 +71,18 @@ public:
   Stmt<T> *returnStatement();
   Stmt<T> *Statement();
   list<Stmt<T> *> block();
+  LazyBody *skipBody();
   Stmt<T> *expressionStatement();
 
 private:
-  vector<Token> tokens;
+  const vector<Token> &tokens;
+  // Pulled from instead of tokens when set
+  TokenStream *stream;
+  Arena &arena;
   int current;
+  // Tokens from end on read as the final EOF_TOK
+  int end;
+  int depth;
 };
 
 #endif
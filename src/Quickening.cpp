@@ -0,0 +1,23 @@
+#include "Quickening.h"
+
+using namespace std;
+
+string quickeningName(Quickening quick) {
+  static const string names[] = {"unseen",
+                                 "generic",
+                                 "add numbers",
+                                 "subtract numbers",
+                                 "multiply numbers",
+                                 "divide numbers",
+                                 "greater numbers",
+                                 "greater equal numbers",
+                                 "less numbers",
+                                 "less equal numbers",
+                                 "equal numbers",
+                                 "not equal numbers",
+                                 "concat strings",
+                                 "negate number",
+                                 "not bool",
+                                 "logical bool"};
+  return names[quick];
+}
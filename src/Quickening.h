@@ -0,0 +1,40 @@
+#ifndef QUICKENING_H
+#define QUICKENING_H
+
+#include <string>
+
+using namespace std;
+
+// Specialization state of a Binary, Unary or Logical site. Sites start
+// unseen, the first evaluation picks the fast path matching the operand types
+// it saw, and a later mismatch sends the site to generic for good
+enum Quickening {
+  QUICK_UNSEEN,
+  QUICK_GENERIC,
+
+  // Binary, both operands numbers
+  QUICK_ADD_NUMBERS,
+  QUICK_SUBTRACT_NUMBERS,
+  QUICK_MULTIPLY_NUMBERS,
+  QUICK_DIVIDE_NUMBERS,
+  QUICK_GREATER_NUMBERS,
+  QUICK_GREATER_EQUAL_NUMBERS,
+  QUICK_LESS_NUMBERS,
+  QUICK_LESS_EQUAL_NUMBERS,
+  QUICK_EQUAL_NUMBERS,
+  QUICK_NOT_EQUAL_NUMBERS,
+
+  // Binary, both operands strings
+  QUICK_CONCAT_STRINGS,
+
+  // Unary
+  QUICK_NEGATE_NUMBER,
+  QUICK_NOT_BOOL,
+
+  // Logical, left operand a bool
+  QUICK_LOGICAL_BOOL
+};
+
+string quickeningName(Quickening quick);
+
+#endif
@@ -0,0 +1,192 @@
+#include "Resolver.h"
+
+#include "Lex.h"
+
+using namespace std;
+
+Resolver::Resolver() : err(false), functionDepth(0) {}
+
+void Resolver::resolve(vector<Stmt<Obj> *> stmts) {
+  for (auto stmt : stmts)
+    resolve(stmt);
+}
+
+void Resolver::resolve(const list<Stmt<Obj> *> &stmts) {
+  for (auto stmt : stmts)
+    resolve(stmt);
+}
+
+void Resolver::resolve(Stmt<Obj> *stmt) { stmt->accept(this); }
+
+void Resolver::resolve(Expr<Obj> *expr) { expr->accept(this); }
+
+void Resolver::resolveLocal(Token name, int &depth, int &slot) {
+  for (int i = scopes.size() - 1; i >= 0; i--) {
+    auto itr = scopes[i].find(name.lexeme);
+    if (itr != scopes[i].end()) {
+      depth = scopes.size() - 1 - i;
+      slot = itr->second.slot;
+      return;
+    }
+  }
+
+  // Not found, assume it's global
+  depth = -1;
+  slot = -1;
+}
+
+void Resolver::resolveFunction(Function<Obj> *function) {
+  functionDepth++;
+
+  // Parameters and body share the environment created by FunctionCallable
+  beginScope();
+  for (auto &param : function->params) {
+    declare(param);
+    define(param);
+  }
+  resolve(function->body);
+  endScope();
+
+  functionDepth--;
+}
+
+void Resolver::beginScope() { scopes.push_back(map<string_view, Local>()); }
+
+void Resolver::endScope() { scopes.pop_back(); }
+
+void Resolver::declare(Token name) {
+  if (scopes.empty())
+    return;
+
+  auto &scope = scopes.back();
+  if (scope.find(name.lexeme) != scope.end()) {
+    error(name, "Already a variable with this name in this scope.");
+    return;
+  }
+
+  // Slots are handed out in declaration order, which is also the order
+  // Environment::define pushes them at runtime
+  int slot = scope.size();
+  scope[name.lexeme] = {slot, false};
+}
+
+void Resolver::define(Token name) {
+  if (scopes.empty())
+    return;
+
+  scopes.back()[name.lexeme].defined = true;
+}
+
+void Resolver::error(Token token, string message) {
+  err = true;
+  report(token.line, " at '" + string(token.lexeme) + "'", message);
+}
+
+Obj Resolver::visitExprAssign(Assign<Obj> *expr) {
+  resolve(expr->value);
+  resolveLocal(expr->name, expr->depth, expr->slot);
+  return monostate();
+}
+
+Obj Resolver::visitExprBinary(Binary<Obj> *expr) {
+  resolve(expr->left);
+  resolve(expr->right);
+  return monostate();
+}
+
+Obj Resolver::visitExprCall(Call<Obj> *expr) {
+  resolve(expr->callee);
+
+  for (auto arg : expr->arguments)
+    resolve(arg);
+
+  return monostate();
+}
+
+Obj Resolver::visitExprGrouping(Grouping<Obj> *expr) {
+  resolve(expr->grouping);
+  return monostate();
+}
+
+Obj Resolver::visitExprLiteral(Literal<Obj> *) { return monostate(); }
+
+Obj Resolver::visitExprLogical(Logical<Obj> *expr) {
+  resolve(expr->left);
+  resolve(expr->right);
+  return monostate();
+}
+
+Obj Resolver::visitExprUnary(Unary<Obj> *expr) {
+  resolve(expr->right);
+  return monostate();
+}
+
+Obj Resolver::visitExprVariable(Variable<Obj> *expr) {
+  if (!scopes.empty()) {
+    auto itr = scopes.back().find(expr->name.lexeme);
+    if (itr != scopes.back().end() && !itr->second.defined)
+      error(expr->name, "Can't read local variable in its own initializer.");
+  }
+
+  resolveLocal(expr->name, expr->depth, expr->slot);
+  return monostate();
+}
+
+Obj Resolver::visitStmtBlock(Block<Obj> *stmt) {
+  beginScope();
+  resolve(stmt->statements);
+  endScope();
+  return monostate();
+}
+
+Obj Resolver::visitStmtExpression(Expression<Obj> *stmt) {
+  resolve(stmt->expr);
+  return monostate();
+}
+
+Obj Resolver::visitStmtFunction(Function<Obj> *stmt) {
+  // Define eagerly so the function can refer to itself
+  declare(stmt->name);
+  define(stmt->name);
+
+  // A deferred body is resolved once it is parsed, on the first call
+  if (stmt->lazy == nullptr)
+    resolveFunction(stmt);
+  return monostate();
+}
+
+Obj Resolver::visitStmtIf(If<Obj> *stmt) {
+  resolve(stmt->condition);
+  resolve(stmt->thenBranch);
+  if (stmt->elseBranch)
+    resolve(stmt->elseBranch);
+  return monostate();
+}
+
+Obj Resolver::visitStmtPrint(Print<Obj> *stmt) {
+  resolve(stmt->expr);
+  return monostate();
+}
+
+Obj Resolver::visitStmtReturn(Return<Obj> *stmt) {
+  if (functionDepth == 0)
+    error(stmt->keyword, "Can't return from top-level code.");
+
+  if (stmt->value)
+    resolve(stmt->value);
+  return monostate();
+}
+
+Obj Resolver::visitStmtVar(Var<Obj> *stmt) {
+  declare(stmt->name);
+  if (stmt->initializer != nullptr)
+    resolve(stmt->initializer);
+  define(stmt->name);
+  return monostate();
+}
+
+Obj Resolver::visitStmtWhile(While<Obj> *stmt) {
+  resolve(stmt->condition);
+  resolve(stmt->body);
+  return monostate();
+}
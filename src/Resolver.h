@@ -0,0 +1,62 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Util.h"
+#include "gen/Expr.hpp"
+#include "gen/Stmt.hpp"
+
+using namespace std;
+
+// Static pass run between the Parser and the Interpreter. Every local variable
+// reference gets the number of scopes to walk up (depth) and its index in that
+// scope (slot), references left with depth -1 are globals
+class Resolver : ExprAstVisitor<Obj>, StmtAstVisitor<Obj> {
+public:
+  bool err;
+  Resolver();
+  void resolve(vector<Stmt<Obj> *> stmts);
+  Obj visitExprAssign(Assign<Obj> *expr) override;
+  Obj visitExprBinary(Binary<Obj> *expr) override;
+  Obj visitExprCall(Call<Obj> *expr) override;
+  Obj visitExprGrouping(Grouping<Obj> *expr) override;
+  Obj visitExprLiteral(Literal<Obj> *expr) override;
+  Obj visitExprLogical(Logical<Obj> *expr) override;
+  Obj visitExprUnary(Unary<Obj> *expr) override;
+  Obj visitExprVariable(Variable<Obj> *expr) override;
+  Obj visitStmtBlock(Block<Obj> *stmt) override;
+  Obj visitStmtExpression(Expression<Obj> *stmt) override;
+  Obj visitStmtFunction(Function<Obj> *stmt) override;
+  Obj visitStmtIf(If<Obj> *stmt) override;
+  Obj visitStmtPrint(Print<Obj> *stmt) override;
+  Obj visitStmtReturn(Return<Obj> *stmt) override;
+  Obj visitStmtVar(Var<Obj> *stmt) override;
+  Obj visitStmtWhile(While<Obj> *stmt) override;
+
+private:
+  struct Local {
+    int slot;
+    bool defined;
+  };
+
+  // Keys are lexemes, views into the source of the unit being resolved
+  vector<map<string_view, Local>> scopes;
+  int functionDepth;
+
+  void resolve(const list<Stmt<Obj> *> &stmts);
+  void resolve(Stmt<Obj> *stmt);
+  void resolve(Expr<Obj> *expr);
+  void resolveLocal(Token name, int &depth, int &slot);
+  void resolveFunction(Function<Obj> *function);
+  void beginScope();
+  void endScope();
+  void declare(Token name);
+  void define(Token name);
+  void error(Token token, string message);
+};
+
+#endif
@@ -0,0 +1,224 @@
+#include "Scan.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SCAN_SIMD 1
+#else
+#define SCAN_SIMD 0
+#endif
+
+using namespace std;
+
+// ----------------------------------------
+// Scalar kernels, also used for the tails shorter than a vector. Newlines are
+// counted in a local, text may alias lines so updating it would be a store
+// per byte
+static size_t skipBlanksScalar(const char *text, size_t size,
+                               unsigned &lines) {
+  size_t i = 0;
+  unsigned newlines = 0;
+  for (; i < size && (text[i] == ' ' || text[i] == '\n'); i++)
+    newlines += text[i] == '\n';
+
+  lines += newlines;
+  return i;
+}
+
+static size_t findNewlineScalar(const char *text, size_t size) {
+  size_t i = 0;
+  while (i < size && text[i] != '\n')
+    i++;
+  return i;
+}
+
+static size_t findQuoteScalar(const char *text, size_t size,
+                              unsigned &lines) {
+  size_t i = 0;
+  unsigned newlines = 0;
+  for (; i < size && text[i] != '"'; i++)
+    newlines += text[i] == '\n';
+
+  lines += newlines;
+  return i;
+}
+
+static const ScanKernels scalarKernels = {"scalar", skipBlanksScalar,
+                                          findNewlineScalar, findQuoteScalar};
+
+#if SCAN_SIMD
+// ----------------------------------------
+// SSE2 kernels, part of every x86-64 CPU. Each compare gives a bit mask of
+// the matching bytes, the first match is its lowest set bit
+static size_t skipBlanksSse2(const char *text, size_t size, unsigned &lines) {
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i newline = _mm_set1_epi8('\n');
+
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(text + i));
+    unsigned newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+    unsigned blanks =
+        newlines | _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, space));
+
+    if (blanks != 0xffff) {
+      unsigned stop = __builtin_ctz(~blanks);
+      lines += __builtin_popcount(newlines & ((1u << stop) - 1));
+      return i + stop;
+    }
+    if (newlines)
+      lines += __builtin_popcount(newlines);
+  }
+
+  return i + skipBlanksScalar(text + i, size - i, lines);
+}
+
+static size_t findNewlineSse2(const char *text, size_t size) {
+  const __m128i newline = _mm_set1_epi8('\n');
+
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(text + i));
+    unsigned newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+    if (newlines)
+      return i + __builtin_ctz(newlines);
+  }
+
+  return i + findNewlineScalar(text + i, size - i);
+}
+
+static size_t findQuoteSse2(const char *text, size_t size, unsigned &lines) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i newline = _mm_set1_epi8('\n');
+
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(text + i));
+    unsigned quotes = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote));
+    unsigned newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+
+    if (quotes) {
+      unsigned stop = __builtin_ctz(quotes);
+      lines += __builtin_popcount(newlines & ((1u << stop) - 1));
+      return i + stop;
+    }
+    if (newlines)
+      lines += __builtin_popcount(newlines);
+  }
+
+  return i + findQuoteScalar(text + i, size - i, lines);
+}
+
+static const ScanKernels sse2Kernels = {"sse2", skipBlanksSse2,
+                                        findNewlineSse2, findQuoteSse2};
+
+// ----------------------------------------
+// AVX2 kernels, the same with 32 bytes per step. Only called after the CPU
+// was checked for AVX2 and POPCNT
+#define AVX2 __attribute__((target("avx2,popcnt")))
+
+AVX2 static size_t skipBlanksAvx2(const char *text, size_t size,
+                                  unsigned &lines) {
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i newline = _mm256_set1_epi8('\n');
+
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)(text + i));
+    unsigned newlines =
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+    unsigned blanks =
+        newlines | _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, space));
+
+    if (blanks != 0xffffffff) {
+      unsigned stop = __builtin_ctz(~blanks);
+      lines += __builtin_popcount(newlines & ((1u << stop) - 1));
+      return i + stop;
+    }
+    lines += __builtin_popcount(newlines);
+  }
+
+  return i + skipBlanksSse2(text + i, size - i, lines);
+}
+
+AVX2 static size_t findNewlineAvx2(const char *text, size_t size) {
+  const __m256i newline = _mm256_set1_epi8('\n');
+
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)(text + i));
+    unsigned newlines =
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+    if (newlines)
+      return i + __builtin_ctz(newlines);
+  }
+
+  return i + findNewlineSse2(text + i, size - i);
+}
+
+AVX2 static size_t findQuoteAvx2(const char *text, size_t size,
+                                 unsigned &lines) {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i newline = _mm256_set1_epi8('\n');
+
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)(text + i));
+    unsigned quotes = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, quote));
+    unsigned newlines =
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+
+    if (quotes) {
+      unsigned stop = __builtin_ctz(quotes);
+      lines += __builtin_popcount(newlines & ((1u << stop) - 1));
+      return i + stop;
+    }
+    lines += __builtin_popcount(newlines);
+  }
+
+  return i + findQuoteSse2(text + i, size - i, lines);
+}
+
+#undef AVX2
+
+static const ScanKernels avx2Kernels = {"avx2", skipBlanksAvx2,
+                                        findNewlineAvx2, findQuoteAvx2};
+
+static bool hasAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+}
+#endif
+
+// ----------------------------------------
+// Dispatch
+static const ScanKernels *forced = nullptr;
+
+static const ScanKernels *detect() {
+#if SCAN_SIMD
+  return hasAvx2() ? &avx2Kernels : &sse2Kernels;
+#else
+  return &scalarKernels;
+#endif
+}
+
+const ScanKernels &scanKernels() {
+  static const ScanKernels *detected = detect();
+  return forced ? *forced : *detected;
+}
+
+bool selectScanKernels(const string &name) {
+  if (name == "auto")
+    forced = nullptr;
+  else if (name == "scalar")
+    forced = &scalarKernels;
+#if SCAN_SIMD
+  else if (name == "sse2")
+    forced = &sse2Kernels;
+  else if (name == "avx2" && hasAvx2())
+    forced = &avx2Kernels;
+#endif
+  else
+    return false;
+
+  return true;
+}
@@ -0,0 +1,29 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstddef>
+#include <string>
+
+using namespace std;
+
+// Byte scanning kernels the Lexer uses on runs of blanks, comments and string
+// literals. Each comes in a scalar version and, on x86-64, in SSE2 and AVX2
+// versions that look at 16 or 32 bytes per step. The best one the CPU
+// supports is picked on first use. Newlines passed over are added to lines
+struct ScanKernels {
+  const char *name;
+  // Length of the run of ' ' and '\n' text starts with
+  size_t (*skipBlanks)(const char *text, size_t size, unsigned &lines);
+  // Offset of the first '\n', or size
+  size_t (*findNewline)(const char *text, size_t size);
+  // Offset of the first '"', or size
+  size_t (*findQuote)(const char *text, size_t size, unsigned &lines);
+};
+
+const ScanKernels &scanKernels();
+
+// Forces the kernels named scalar, sse2 or avx2, or goes back to the detected
+// ones for auto. False when this build or CPU does not have them
+bool selectScanKernels(const string &name);
+
+#endif
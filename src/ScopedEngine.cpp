@@ -0,0 +1,76 @@
+#include "ScopedEngine.h"
+
+#include <iostream>
+
+#include "Callable.h"
+#include "Interner.h"
+
+using namespace std;
+
+ScopedEngine::ScopedEngine() : err(false), completion(COMPLETION_NORMAL) {
+  globals = gc().allocate<Environment>();
+  env = globals;
+  gc().addRoots(this);
+
+  // The name is interned first, so the native is rooted as soon as it exists
+  int clock = interner().symbol("clock");
+  globals->define(clock, gc().allocate<ClockCallable>());
+}
+
+// Everything the engine allocated is left for the collector
+ScopedEngine::~ScopedEngine() { gc().removeRoots(this); }
+
+Environment *ScopedEngine::newEnvironment(Environment *enclosing) {
+  if (freeEnvironments.empty())
+    return gc().allocate<Environment>(enclosing);
+
+  Environment *env = freeEnvironments.back();
+  freeEnvironments.pop_back();
+  env->reset(enclosing);
+  return env;
+}
+
+// Blocks and calls hand their environment back on exit. Nothing can refer to
+// it afterwards unless a closure was created inside
+void ScopedEngine::releaseEnvironment(Environment *env) {
+  if (env->isCaptured())
+    return;
+
+  // Dropped values must not be kept alive by the pool
+  env->reset(nullptr);
+  freeEnvironments.push_back(env);
+}
+
+void ScopedEngine::markRoots(Gc &gc) {
+  gc.markObject(globals);
+  gc.markObject(env);
+  for (auto saved : savedEnvironments)
+    gc.markObject(saved);
+  for (auto pooled : freeEnvironments)
+    gc.markObject(pooled);
+  for (auto &value : temps)
+    gc.markValue(value);
+}
+
+void ScopedEngine::define(const Token &name, Obj value) {
+  // Top level declarations stay addressable by name, everything else was
+  // given a slot by the Resolver
+  if (env == globals)
+    globals->define(name.symbol, value);
+  else
+    env->define(value);
+}
+
+bool ScopedEngine::isTrue(Obj value) {
+  if (value.isNil())
+    return false;
+  else if (value.isBool())
+    return value.asBool();
+  else
+    return true;
+}
+
+void ScopedEngine::runtimeError(const RuntimeError &error) {
+  cout << "[line " + to_string(error.token.line) + "] " << error.what() << endl;
+  err = true;
+}
@@ -0,0 +1,110 @@
+#ifndef SCOPED_ENGINE_H
+#define SCOPED_ENGINE_H
+
+#include <list>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Environment.h"
+#include "Gc.h"
+#include "Util.h"
+
+using namespace std;
+
+class RuntimeError : public runtime_error {
+public:
+  Token token;
+  RuntimeError(Token token, string message)
+      : runtime_error(message), token(token) {}
+};
+
+// How the last executed statement finished. On COMPLETION_RETURN statement
+// visitors hand the returned value back instead of nil
+enum Completion { COMPLETION_NORMAL, COMPLETION_RETURN };
+
+// Runtime state of the engines that keep scopes in Environments: the
+// Interpreter, ClosureCompiler and FlatInterpreter. Holds the current scope,
+// the pool of released ones and the values only C++ locals refer to, and
+// reports all of them to the collector
+class ScopedEngine : public GcRoots {
+public:
+  bool err;
+  Completion completion;
+  Environment *globals;
+  ScopedEngine();
+  ~ScopedEngine();
+  Environment *newEnvironment(Environment *enclosing);
+  void releaseEnvironment(Environment *env);
+  void markRoots(Gc &gc) override;
+
+  // Runs a function body in a new scope enclosed by closure, the parameters
+  // taking its first slots. execute runs the body in that scope
+  template <typename Execute>
+  Obj callFunction(Environment *closure, const list<Obj> &arguments,
+                   Execute execute);
+
+protected:
+  Environment *env;
+  // Released scopes waiting to be reused
+  vector<Environment *> freeEnvironments;
+  // Scopes active further down the native call stack
+  vector<Environment *> savedEnvironments;
+  // Intermediate values held only by C++ locals while evaluation continues
+  vector<Obj> temps;
+
+  // Runs the statements in [first, last) with env as the current scope, up
+  // to a return. env goes back to the pool afterwards
+  template <typename Iterator, typename Execute>
+  Obj runBlock(Iterator first, Iterator last, Environment *env,
+               Execute execute);
+  void define(const Token &name, Obj value);
+  static bool isTrue(Obj value);
+  void runtimeError(const RuntimeError &error);
+};
+
+template <typename Execute>
+Obj ScopedEngine::callFunction(Environment *closure, const list<Obj> &arguments,
+                               Execute execute) {
+  Environment *env = newEnvironment(closure);
+  for (auto &arg : arguments)
+    env->define(arg);
+
+  Obj value = execute(env);
+  if (completion != COMPLETION_RETURN)
+    return monostate();
+
+  completion = COMPLETION_NORMAL;
+  return value;
+}
+
+template <typename Iterator, typename Execute>
+Obj ScopedEngine::runBlock(Iterator first, Iterator last, Environment *env,
+                           Execute execute) {
+  // The caller's scope may not be reachable from the new one, so it is
+  // saved where the collector can see it
+  Environment *previous = this->env;
+  savedEnvironments.push_back(previous);
+  Obj value = monostate();
+  try {
+    this->env = env;
+
+    for (; first != last; ++first) {
+      value = execute(*first);
+      if (completion == COMPLETION_RETURN)
+        break;
+    }
+  } catch (...) {
+    this->env = previous;
+    savedEnvironments.pop_back();
+    releaseEnvironment(env);
+    throw;
+  }
+
+  this->env = previous;
+  savedEnvironments.pop_back();
+  releaseEnvironment(env);
+  return value;
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "ScriptCache.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CacheStream.h"
+#include "gen/AstCache.hpp"
+
+using namespace std;
+
+// "LOXC" read as a little endian word
+#define SCRIPT_CACHE_MAGIC 0x43584f4cu
+
+ScriptCache::ScriptCache(string path) : path(std::move(path)) {}
+
+uint64_t ScriptCache::hash(string_view src) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (unsigned char c : src)
+    hash = (hash ^ c) * 0x100000001b3;
+  return hash;
+}
+
+bool ScriptCache::load(string_view src, Arena &arena,
+                       vector<Stmt<Obj> *> &statements) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    close(fd);
+    return false;
+  }
+
+  void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  bool loaded = false;
+  try {
+    CacheReader in((const uint8_t *)data, info.st_size, src);
+    if (in.u32() == SCRIPT_CACHE_MAGIC && in.u32() == SCRIPT_CACHE_VERSION &&
+        in.u32() == AST_CACHE_LAYOUT && in.u64() == src.size() &&
+        in.u64() == hash(src)) {
+      statements = AstReader<Obj>(in, arena).read();
+      loaded = in.atEnd();
+    }
+  } catch (const CacheError &) {
+    loaded = false;
+  }
+
+  munmap(data, info.st_size);
+  return loaded;
+}
+
+// Best effort, a script that can't be cached still runs. The file is
+// replaced in one rename, so a reader never sees it half written
+void ScriptCache::store(string_view src,
+                        const vector<Stmt<Obj> *> &statements) {
+  CacheWriter out(src);
+  try {
+    out.u32(SCRIPT_CACHE_MAGIC);
+    out.u32(SCRIPT_CACHE_VERSION);
+    out.u32(AST_CACHE_LAYOUT);
+    out.u64(src.size());
+    out.u64(hash(src));
+    AstWriter<Obj>(out).write(statements);
+  } catch (const CacheError &) {
+    return;
+  }
+
+  string temp = path + ".tmp";
+  FILE *file = fopen(temp.c_str(), "wb");
+  if (!file)
+    return;
+
+  bool written =
+      fwrite(out.bytes.data(), 1, out.bytes.size(), file) == out.bytes.size();
+  written &= fclose(file) == 0;
+
+  if (!written || rename(temp.c_str(), path.c_str()) != 0)
+    remove(temp.c_str());
+}
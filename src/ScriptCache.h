@@ -0,0 +1,33 @@
+#ifndef SCRIPT_CACHE_H
+#define SCRIPT_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Arena.h"
+#include "gen/Stmt.hpp"
+
+using namespace std;
+
+// Bump when the encoding in CacheStream or the header changes
+#define SCRIPT_CACHE_VERSION 1
+
+// Parsed scripts saved next to their source as <script>.loxc (--cache), like
+// Python's .pyc. The header names the format version, the generated AST
+// layout and the size and FNV-1a hash of the source it was made from, a
+// cache that doesn't match all of them is stale and gets rewritten
+class ScriptCache {
+public:
+  ScriptCache(string path);
+  // Rebuilds the script's statements in arena, false if it must be parsed
+  bool load(string_view src, Arena &arena, vector<Stmt<Obj> *> &statements);
+  void store(string_view src, const vector<Stmt<Obj> *> &statements);
+  static uint64_t hash(string_view src);
+
+private:
+  string path;
+};
+
+#endif
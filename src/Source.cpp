@@ -0,0 +1,74 @@
+#include "Source.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Bytes asked for by each read when a file can't be mapped
+#define SOURCE_READ_SIZE 65536
+
+Source::Source() : mapping(nullptr), size(0) {}
+
+Source::Source(string text)
+    : buffer(std::move(text)), mapping(nullptr), size(0) {}
+
+Source::Source(Source &&other)
+    : buffer(std::move(other.buffer)), mapping(other.mapping),
+      size(other.size) {
+  other.mapping = nullptr;
+  other.size = 0;
+}
+
+Source::~Source() {
+  if (mapping)
+    munmap(mapping, size);
+}
+
+bool Source::load(const char *path) {
+  int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  // Mapping a file of size 0 fails, and there is nothing to map anyway
+  struct stat info;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    void *text = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text != MAP_FAILED) {
+      mapping = text;
+      size = info.st_size;
+    }
+  }
+
+  bool loaded = mapping != nullptr || readAll(fd);
+  if (fd != STDIN_FILENO)
+    close(fd);
+  return loaded;
+}
+
+string_view Source::text() const {
+  if (mapping)
+    return string_view(static_cast<const char *>(mapping), size);
+  return buffer;
+}
+
+// Reads fd into the buffer up to its end
+bool Source::readAll(int fd) {
+  for (;;) {
+    size_t used = buffer.size();
+    buffer.resize(used + SOURCE_READ_SIZE);
+    ssize_t count = read(fd, &buffer[used], SOURCE_READ_SIZE);
+    buffer.resize(count > 0 ? used + count : used);
+
+    if (count == 0)
+      return true;
+    if (count < 0 && errno != EINTR) {
+      buffer.clear();
+      return false;
+    }
+  }
+}
@@ -0,0 +1,35 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// Text of a script. Regular files are mapped into memory and lexed in place,
+// anything that can't be mapped (pipes, stdin, empty files) is read into a
+// buffer instead. Tokens point into the text, so it must outlive them
+class Source {
+public:
+  Source();
+  Source(string text);
+  Source(Source &&other);
+  ~Source();
+  Source(const Source &) = delete;
+  Source &operator=(const Source &) = delete;
+
+  // Loads the file at path, or stdin for "-". False if it can't be read
+  bool load(const char *path);
+  string_view text() const;
+
+private:
+  string buffer;
+  // Mapped file, nullptr when the text is in buffer
+  void *mapping;
+  size_t size;
+
+  bool readAll(int fd);
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "TokenStream.h"
+
+#include <cassert>
+
+using namespace std;
+
+TokenStream::TokenStream(Lexer &lexer)
+    : lexer(lexer),
+      ring(TOKEN_STREAM_WINDOW, Token(EOF_TOK, "", monostate(), 0)),
+      position(0), filled(0) {
+  fill();
+}
+
+// Token distance places past the current one, at most the window allows
+const Token &TokenStream::peek(int distance) {
+  assert(distance < TOKEN_STREAM_WINDOW - 1);
+  while (filled <= position + distance)
+    fill();
+  return ring[(position + distance) & (TOKEN_STREAM_WINDOW - 1)];
+}
+
+const Token &TokenStream::previous() {
+  return ring[(position - 1) & (TOKEN_STREAM_WINDOW - 1)];
+}
+
+// Moves to the next token. The stream stays on the final EOF_TOK
+void TokenStream::advance() {
+  if (peek().type == EOF_TOK)
+    return;
+
+  position++;
+  if (filled == position)
+    fill();
+}
+
+size_t TokenStream::lexed() { return filled; }
+
+void TokenStream::fill() {
+  // Past the end the lexer keeps handing out EOF_TOK
+  ring[filled & (TOKEN_STREAM_WINDOW - 1)] = lexer.nextToken();
+  filled++;
+}
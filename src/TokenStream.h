@@ -0,0 +1,36 @@
+#ifndef TOKEN_STREAM_H
+#define TOKEN_STREAM_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Lex.h"
+
+using namespace std;
+
+// Tokens kept by a TokenStream: the previous one, the current one and the
+// lookahead past it. A power of two
+#define TOKEN_STREAM_WINDOW 4
+
+// Pull-based token source for the Parser. Tokens are lexed on demand into a
+// ring buffer, so however large the source, only a few exist at a time. They
+// stay valid until TOKEN_STREAM_WINDOW - 1 more have been consumed, callers
+// keep a copy of anything they need for longer
+class TokenStream {
+public:
+  TokenStream(Lexer &lexer);
+  const Token &peek(int distance = 0);
+  const Token &previous();
+  void advance();
+  size_t lexed();
+
+private:
+  Lexer &lexer;
+  vector<Token> ring;
+  // Index of the current token, and count of the tokens lexed so far
+  size_t position, filled;
+
+  void fill();
+};
+
+#endif
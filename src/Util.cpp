@@ -5,12 +5,12 @@
 using namespace std;
 
 string to_string(const Obj &val) {
-  if (holds_alternative<string>(val))
-    return get<string>(val);
-  else if (holds_alternative<double>(val))
-    return to_string(get<double>(val));
-  else if (holds_alternative<bool>(val))
-    return to_string(get<bool>(val));
+  if (val.isString())
+    return val.asString()->value;
+  else if (val.isNumber())
+    return to_string(val.asNumber());
+  else if (val.isBool())
+    return val.asBool() ? "true" : "false";
   else
     return "nil";
 }
@@ -0,0 +1,401 @@
+#include "VM.h"
+
+#include <iostream>
+
+#include "Interner.h"
+
+using namespace std;
+
+// Deepest call chain before reporting a stack overflow
+#define FRAMES_MAX 16384
+
+// ----------------------------------------
+// Closure function definitions
+VmClosure::VmClosure(VM &vm, VmFunction *function)
+    : function(function), upvalues(function->upvalueCount, nullptr), vm(vm) {}
+
+int VmClosure::arity() { return function->arity; }
+
+Obj VmClosure::call(list<Obj> arguments) { return vm.call(this, arguments); }
+
+string VmClosure::to_string() { return "<fn " + function->name; }
+
+void VmClosure::trace(Gc &gc) {
+  for (auto upvalue : upvalues)
+    gc.markObject(upvalue);
+}
+
+// Open upvalues point at the stack, which is a root already
+void VmUpvalue::trace(Gc &gc) { gc.markValue(closed); }
+
+// ----------------------------------------
+// VM function definitions
+VM::VM() : err(false), openUpvalues(nullptr) {
+  // Frames are referenced by pointer while running, so they never move
+  frames.reserve(FRAMES_MAX);
+
+  gc().addRoots(this);
+  int clock = interner().symbol("clock");
+  defineGlobal(clock, static_cast<Callable *>(gc().allocate<ClockCallable>()));
+}
+
+VM::~VM() { gc().removeRoots(this); }
+
+void VM::markRoots(Gc &gc) {
+  for (auto &value : stack)
+    gc.markValue(value);
+  for (auto &value : globals)
+    gc.markValue(value);
+  for (auto &frame : frames)
+    gc.markObject(frame.closure);
+  for (auto upvalue = openUpvalues; upvalue; upvalue = upvalue->nextOpen)
+    gc.markObject(upvalue);
+}
+
+void VM::interpret(VmFunction *script) {
+  try {
+    VmClosure *closure = gc().allocate<VmClosure>(*this, script);
+    push(static_cast<Callable *>(closure));
+    callClosure(closure, 0, 0);
+    run(0);
+    pop();
+  } catch (const RuntimeError &error) {
+    cout << "[line " + to_string(error.token.line) + "] " << error.what()
+         << endl;
+    err = true;
+
+    stack.clear();
+    frames.clear();
+    openUpvalues = nullptr;
+  }
+}
+
+Obj VM::call(VmClosure *closure, list<Obj> arguments) {
+  size_t exitDepth = frames.size();
+
+  push(static_cast<Callable *>(closure));
+  for (auto &arg : arguments)
+    push(arg);
+
+  callClosure(closure, arguments.size(), 0);
+  run(exitDepth);
+  return pop();
+}
+
+void VM::push(Obj value) { stack.push_back(value); }
+
+Obj VM::pop() {
+  Obj value = stack.back();
+  stack.pop_back();
+  return value;
+}
+
+Obj &VM::peek(int distance) { return stack[stack.size() - 1 - distance]; }
+
+void VM::callValue(Obj callee, int argCount, int line) {
+  if (!callee.isCallable())
+    throw runtimeError(line, "Can only call functions and classes.");
+
+  Callable *function = callee.asCallable();
+  auto closure = dynamic_cast<VmClosure *>(function);
+  if (closure) {
+    callClosure(closure, argCount, line);
+    return;
+  }
+
+  // Natives receive their arguments as a list, like in the Interpreter
+  if (argCount != function->arity())
+    throw runtimeError(line, string("Expected ") +
+                                 to_string(function->arity()) +
+                                 string(" arguments but got ") +
+                                 to_string(argCount) + string("."));
+
+  list<Obj> arguments(stack.end() - argCount, stack.end());
+  Obj result = function->call(arguments);
+  stack.resize(stack.size() - argCount - 1);
+  push(result);
+}
+
+void VM::callClosure(VmClosure *closure, int argCount, int line) {
+  if (argCount != closure->function->arity)
+    throw runtimeError(line, string("Expected ") +
+                                 to_string(closure->function->arity) +
+                                 string(" arguments but got ") +
+                                 to_string(argCount) + string("."));
+
+  if (frames.size() == FRAMES_MAX)
+    throw runtimeError(line, "Stack overflow.");
+
+  frames.push_back({closure, closure->function->chunk.code.data(),
+                    stack.size() - argCount - 1});
+}
+
+VmUpvalue *VM::captureUpvalue(size_t slot) {
+  // Open upvalues are sorted by slot, top of the stack first
+  VmUpvalue *prev = nullptr;
+  VmUpvalue *upvalue = openUpvalues;
+  while (upvalue != nullptr && upvalue->slot > slot) {
+    prev = upvalue;
+    upvalue = upvalue->nextOpen;
+  }
+
+  if (upvalue != nullptr && upvalue->slot == slot)
+    return upvalue;
+
+  VmUpvalue *created = gc().allocate<VmUpvalue>(slot);
+  created->nextOpen = upvalue;
+
+  if (prev == nullptr)
+    openUpvalues = created;
+  else
+    prev->nextOpen = created;
+
+  return created;
+}
+
+Obj &VM::upvalueValue(VmUpvalue *upvalue) {
+  return upvalue->isOpen ? stack[upvalue->slot] : upvalue->closed;
+}
+
+void VM::closeUpvalues(size_t last) {
+  while (openUpvalues != nullptr && openUpvalues->slot >= last) {
+    VmUpvalue *upvalue = openUpvalues;
+    upvalue->closed = stack[upvalue->slot];
+    upvalue->isOpen = false;
+    openUpvalues = upvalue->nextOpen;
+  }
+}
+
+bool VM::isTrue(const Obj &value) {
+  if (value.isNil())
+    return false;
+  else if (value.isBool())
+    return value.asBool();
+  else
+    return true;
+}
+
+bool VM::isEqual(const Obj &v1, const Obj &v2) { return v1 == v2; }
+
+void VM::checkNumberOperand(int line, const Obj &operand) {
+  if (operand.isNumber())
+    return;
+  throw runtimeError(line, "Operand must be a number!");
+}
+
+void VM::checkNumberOperands(int line, const Obj &left, const Obj &right) {
+  checkNumberOperand(line, left);
+  checkNumberOperand(line, right);
+}
+
+RuntimeError VM::runtimeError(int line, string message) {
+  return RuntimeError(Token(EOF_TOK, "", monostate(), line), message);
+}
+
+void VM::defineGlobal(int symbol, Obj value) {
+  if (symbol >= (int)globals.size())
+    globals.resize(symbol + 1, Obj::undefined());
+
+  globals[symbol] = value;
+}
+
+RuntimeError VM::undefinedVariable(int line, int symbol) {
+  return runtimeError(line, "Undefined variable '" +
+                                interner().name(symbol)->value + "'.");
+}
+
+void VM::run(size_t exitDepth) {
+  CallFrame *frame = &frames.back();
+  Chunk *chunk = &frame->closure->function->chunk;
+
+#define READ_BYTE() (*frame->ip++)
+#define READ_SHORT()                                                           \
+  (frame->ip += 2, (uint16_t)((frame->ip[-2] << 8) | frame->ip[-1]))
+#define READ_LONG()                                                            \
+  (frame->ip += 3,                                                             \
+   (uint32_t)((frame->ip[-3] << 16) | (frame->ip[-2] << 8) | frame->ip[-1]))
+#define READ_CONSTANT() (chunk->constants[READ_SHORT()])
+#define LINE() (chunk->lines[frame->ip - chunk->code.data() - 1])
+#define BINARY_OP(op)                                                          \
+  do {                                                                         \
+    Obj right = pop();                                                         \
+    Obj left = pop();                                                          \
+    checkNumberOperands(LINE(), left, right);                                  \
+    push(left.asNumber() op right.asNumber());                                 \
+  } while (false)
+
+  for (;;) {
+    uint8_t instruction = READ_BYTE();
+    switch (instruction) {
+    case OP_CONSTANT:
+      push(READ_CONSTANT());
+      break;
+    case OP_CONSTANT_LONG:
+      push(chunk->constants[READ_LONG()]);
+      break;
+    case OP_NIL:
+      push(monostate());
+      break;
+    case OP_TRUE:
+      push(true);
+      break;
+    case OP_FALSE:
+      push(false);
+      break;
+    case OP_POP:
+      pop();
+      break;
+    case OP_GET_LOCAL:
+      push(stack[frame->slots + READ_BYTE()]);
+      break;
+    case OP_SET_LOCAL:
+      stack[frame->slots + READ_BYTE()] = peek(0);
+      break;
+    case OP_GET_GLOBAL: {
+      uint32_t symbol = READ_LONG();
+      if (symbol >= globals.size() || globals[symbol].isUndefined())
+        throw undefinedVariable(LINE(), symbol);
+      push(globals[symbol]);
+      break;
+    }
+    case OP_DEFINE_GLOBAL:
+      defineGlobal(READ_LONG(), peek(0));
+      pop();
+      break;
+    case OP_SET_GLOBAL: {
+      uint32_t symbol = READ_LONG();
+      if (symbol >= globals.size() || globals[symbol].isUndefined())
+        throw undefinedVariable(LINE(), symbol);
+      globals[symbol] = peek(0);
+      break;
+    }
+    case OP_GET_UPVALUE:
+      push(upvalueValue(frame->closure->upvalues[READ_BYTE()]));
+      break;
+    case OP_SET_UPVALUE:
+      upvalueValue(frame->closure->upvalues[READ_BYTE()]) = peek(0);
+      break;
+    case OP_EQUAL: {
+      Obj right = pop();
+      Obj left = pop();
+      push(isEqual(left, right));
+      break;
+    }
+    case OP_NOT_EQUAL: {
+      Obj right = pop();
+      Obj left = pop();
+      push(!isEqual(left, right));
+      break;
+    }
+    case OP_GREATER:
+      BINARY_OP(>);
+      break;
+    case OP_GREATER_EQUAL:
+      BINARY_OP(>=);
+      break;
+    case OP_LESS:
+      BINARY_OP(<);
+      break;
+    case OP_LESS_EQUAL:
+      BINARY_OP(<=);
+      break;
+    case OP_ADD: {
+      Obj right = pop();
+      Obj left = pop();
+      if (left.isNumber() && right.isNumber())
+        push(left.asNumber() + right.asNumber());
+      else if (left.isString() && right.isString())
+        push(newString(left.asString()->value + right.asString()->value));
+      else
+        throw runtimeError(LINE(), "Operands must be two numbers or strings");
+      break;
+    }
+    case OP_SUBTRACT:
+      BINARY_OP(-);
+      break;
+    case OP_MULTIPLY:
+      BINARY_OP(*);
+      break;
+    case OP_DIVIDE:
+      BINARY_OP(/);
+      break;
+    case OP_NOT:
+      push(!isTrue(pop()));
+      break;
+    case OP_NEGATE: {
+      Obj value = pop();
+      checkNumberOperand(LINE(), value);
+      push(-value.asNumber());
+      break;
+    }
+    case OP_PRINT:
+      cout << to_string(pop()) << endl;
+      break;
+    case OP_JUMP: {
+      uint16_t offset = READ_SHORT();
+      frame->ip += offset;
+      break;
+    }
+    case OP_JUMP_IF_FALSE: {
+      uint16_t offset = READ_SHORT();
+      if (!isTrue(peek(0)))
+        frame->ip += offset;
+      break;
+    }
+    case OP_LOOP: {
+      uint16_t offset = READ_SHORT();
+      frame->ip -= offset;
+      break;
+    }
+    case OP_CALL: {
+      int argCount = READ_BYTE();
+      callValue(peek(argCount), argCount, LINE());
+      frame = &frames.back();
+      chunk = &frame->closure->function->chunk;
+      break;
+    }
+    case OP_CLOSURE: {
+      VmFunction *function = chunk->functions[READ_SHORT()].get();
+      VmClosure *closure = gc().allocate<VmClosure>(*this, function);
+      // Pushed first, capturing upvalues allocates and may collect
+      push(static_cast<Callable *>(closure));
+      for (int i = 0; i < function->upvalueCount; i++) {
+        uint8_t isLocal = READ_BYTE();
+        uint8_t index = READ_BYTE();
+        if (isLocal)
+          closure->upvalues[i] = captureUpvalue(frame->slots + index);
+        else
+          closure->upvalues[i] = frame->closure->upvalues[index];
+      }
+      break;
+    }
+    case OP_CLOSE_UPVALUE:
+      closeUpvalues(stack.size() - 1);
+      pop();
+      break;
+    case OP_RETURN: {
+      Obj result = pop();
+      closeUpvalues(frame->slots);
+
+      size_t slots = frame->slots;
+      frames.pop_back();
+      stack.resize(slots);
+      push(result);
+
+      if (frames.size() == exitDepth)
+        return;
+
+      frame = &frames.back();
+      chunk = &frame->closure->function->chunk;
+      break;
+    }
+    }
+  }
+
+#undef READ_BYTE
+#undef READ_SHORT
+#undef READ_LONG
+#undef READ_CONSTANT
+#undef LINE
+#undef BINARY_OP
+}
@@ -0,0 +1,89 @@
+#ifndef VM_H
+#define VM_H
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Callable.h"
+#include "Chunk.h"
+#include "Gc.h"
+#include "Interpreter.h"
+#include "Util.h"
+
+using namespace std;
+
+class VM;
+
+// Captured variable. While open it points at a stack slot, once the slot goes
+// out of scope the value moves into the upvalue itself
+class VmUpvalue : public HeapObj {
+public:
+  size_t slot;
+  bool isOpen;
+  Obj closed;
+  VmUpvalue *nextOpen;
+
+  VmUpvalue(size_t slot)
+      : HeapObj(OBJ_UPVALUE), slot(slot), isOpen(true), closed(monostate()),
+        nextOpen(nullptr) {}
+  void trace(Gc &gc) override;
+};
+
+class VmClosure : public Callable {
+public:
+  VmFunction *function;
+  vector<VmUpvalue *> upvalues;
+
+  VmClosure(VM &vm, VmFunction *function);
+  int arity() override;
+  Obj call(list<Obj> arguments) override;
+  string to_string() override;
+  void trace(Gc &gc) override;
+
+private:
+  VM &vm;
+};
+
+class VM : public GcRoots {
+public:
+  bool err;
+  VM();
+  ~VM();
+  void markRoots(Gc &gc) override;
+  void interpret(VmFunction *script);
+  Obj call(VmClosure *closure, list<Obj> arguments);
+
+private:
+  struct CallFrame {
+    VmClosure *closure;
+    uint8_t *ip;
+    size_t slots;
+  };
+
+  vector<Obj> stack;
+  vector<CallFrame> frames;
+  // Indexed by symbol id, see Interner.h
+  vector<Obj> globals;
+  VmUpvalue *openUpvalues;
+
+  void run(size_t exitDepth);
+  void defineGlobal(int symbol, Obj value);
+  RuntimeError undefinedVariable(int line, int symbol);
+  void push(Obj value);
+  Obj pop();
+  Obj &peek(int distance);
+  void callValue(Obj callee, int argCount, int line);
+  void callClosure(VmClosure *closure, int argCount, int line);
+  VmUpvalue *captureUpvalue(size_t slot);
+  Obj &upvalueValue(VmUpvalue *upvalue);
+  void closeUpvalues(size_t last);
+  bool isTrue(const Obj &value);
+  bool isEqual(const Obj &v1, const Obj &v2);
+  void checkNumberOperand(int line, const Obj &operand);
+  void checkNumberOperands(int line, const Obj &left, const Obj &right);
+  RuntimeError runtimeError(int line, string message);
+};
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef AST_CACHE_HPP
+#define AST_CACHE_HPP
+#include <cstdint>
+#include <list>
+#include <vector>
+#include "../Arena.h"
+#include "../CacheStream.h"
+#include "Expr.hpp"
+#include "Stmt.hpp"
+using namespace std;
+
+// Changes whenever the nodes or their stored fields do
+#define AST_CACHE_LAYOUT 0xd13ad2e8u
+
+// Writes nodes in pre-order: a tag, 0 for null and kind + 1 otherwise,
+// followed by the stored fields
+template <typename T>
+class AstWriter : ExprAstVisitor<T>, StmtAstVisitor<T> {
+public:
+  AstWriter(CacheWriter &out) : out(out) {}
+  void write(const vector<Stmt<T> *> &stmts) {
+    out.u32(stmts.size());
+    for (auto stmt : stmts)
+      write(stmt);
+  }
+  T visitExprBinary (Binary<T>* node) override {
+    write(node->left);
+    write(node->op);
+    write(node->right);
+    return T();
+  }
+  T visitExprCall (Call<T>* node) override {
+    write(node->callee);
+    write(node->paren);
+    write(node->arguments);
+    return T();
+  }
+  T visitExprGrouping (Grouping<T>* node) override {
+    write(node->grouping);
+    return T();
+  }
+  T visitExprLiteral (Literal<T>* node) override {
+    write(node->value);
+    return T();
+  }
+  T visitExprLogical (Logical<T>* node) override {
+    write(node->left);
+    write(node->op);
+    write(node->right);
+    return T();
+  }
+  T visitExprUnary (Unary<T>* node) override {
+    write(node->op);
+    write(node->right);
+    return T();
+  }
+  T visitExprVariable (Variable<T>* node) override {
+    write(node->name);
+    return T();
+  }
+  T visitExprAssign (Assign<T>* node) override {
+    write(node->name);
+    write(node->value);
+    return T();
+  }
+  T visitStmtExpression (Expression<T>* node) override {
+    write(node->expr);
+    return T();
+  }
+  T visitStmtFunction (Function<T>* node) override {
+    write(node->name);
+    write(node->params);
+    write(node->body);
+    return T();
+  }
+  T visitStmtIf (If<T>* node) override {
+    write(node->condition);
+    write(node->thenBranch);
+    write(node->elseBranch);
+    return T();
+  }
+  T visitStmtPrint (Print<T>* node) override {
+    write(node->expr);
+    return T();
+  }
+  T visitStmtReturn (Return<T>* node) override {
+    write(node->keyword);
+    write(node->value);
+    return T();
+  }
+  T visitStmtVar (Var<T>* node) override {
+    write(node->name);
+    write(node->initializer);
+    return T();
+  }
+  T visitStmtWhile (While<T>* node) override {
+    write(node->condition);
+    write(node->body);
+    return T();
+  }
+  T visitStmtBlock (Block<T>* node) override {
+    write(node->statements);
+    return T();
+  }
+
+private:
+  CacheWriter &out;
+  void write(Expr<T> *node) {
+    if (node == nullptr) {
+      out.u8(0);
+      return;
+    }
+    out.u8(node->kind + 1);
+    node->accept(this);
+  }
+  void write(Stmt<T> *node) {
+    if (node == nullptr) {
+      out.u8(0);
+      return;
+    }
+    out.u8(node->kind + 1);
+    node->accept(this);
+  }
+  template <typename Item> void write(const list<Item> &items) {
+    out.u32(items.size());
+    for (auto &item : items)
+      write(item);
+  }
+  void write(const Token &value) { out.write(value); }
+  void write(Obj value) { out.write(value); }
+  void write(int value) { out.write(value); }
+};
+
+// Rebuilds in an Arena what AstWriter wrote, a malformed stream makes the
+// CacheReader throw
+template <typename T>
+class AstReader {
+public:
+  AstReader(CacheReader &in, Arena &arena) : in(in), arena(arena) {}
+  vector<Stmt<T> *> read() {
+    vector<Stmt<T> *> stmts;
+    for (uint32_t count = in.u32(); count > 0; count--)
+      stmts.push_back(readStmt());
+    return stmts;
+  }
+
+private:
+  CacheReader &in;
+  Arena &arena;
+  Expr<T> *readExpr() {
+    uint8_t tag = in.u8();
+    if (tag == 0)
+      return nullptr;
+
+    switch (tag - 1) {
+    case EXPR_BINARY: {
+      auto left = readExpr();
+      auto op = in.token();
+      auto right = readExpr();
+      return new (arena) Binary<T>(left, op, right);
+    }
+    case EXPR_CALL: {
+      auto callee = readExpr();
+      auto paren = in.token();
+      auto arguments = readExprs();
+      return new (arena) Call<T>(callee, paren, arguments);
+    }
+    case EXPR_GROUPING: {
+      auto grouping = readExpr();
+      return new (arena) Grouping<T>(grouping);
+    }
+    case EXPR_LITERAL: {
+      auto value = in.value();
+      return new (arena) Literal<T>(value);
+    }
+    case EXPR_LOGICAL: {
+      auto left = readExpr();
+      auto op = in.token();
+      auto right = readExpr();
+      return new (arena) Logical<T>(left, op, right);
+    }
+    case EXPR_UNARY: {
+      auto op = in.token();
+      auto right = readExpr();
+      return new (arena) Unary<T>(op, right);
+    }
+    case EXPR_VARIABLE: {
+      auto name = in.token();
+      return new (arena) Variable<T>(name);
+    }
+    case EXPR_ASSIGN: {
+      auto name = in.token();
+      auto value = readExpr();
+      return new (arena) Assign<T>(name, value);
+    }
+    default:
+      in.fail();
+    }
+  }
+  Stmt<T> *readStmt() {
+    uint8_t tag = in.u8();
+    if (tag == 0)
+      return nullptr;
+
+    switch (tag - 1) {
+    case STMT_EXPRESSION: {
+      auto expr = readExpr();
+      return new (arena) Expression<T>(expr);
+    }
+    case STMT_FUNCTION: {
+      auto name = in.token();
+      auto params = readTokens();
+      auto body = readStmts();
+      return new (arena) Function<T>(name, params, body);
+    }
+    case STMT_IF: {
+      auto condition = readExpr();
+      auto thenBranch = readStmt();
+      auto elseBranch = readStmt();
+      return new (arena) If<T>(condition, thenBranch, elseBranch);
+    }
+    case STMT_PRINT: {
+      auto expr = readExpr();
+      return new (arena) Print<T>(expr);
+    }
+    case STMT_RETURN: {
+      auto keyword = in.token();
+      auto value = readExpr();
+      return new (arena) Return<T>(keyword, value);
+    }
+    case STMT_VAR: {
+      auto name = in.token();
+      auto initializer = readExpr();
+      return new (arena) Var<T>(name, initializer);
+    }
+    case STMT_WHILE: {
+      auto condition = readExpr();
+      auto body = readStmt();
+      return new (arena) While<T>(condition, body);
+    }
+    case STMT_BLOCK: {
+      auto statements = readStmts();
+      return new (arena) Block<T>(statements);
+    }
+    default:
+      in.fail();
+    }
+  }
+  list<Expr<T> *> readExprs() {
+    list<Expr<T> *> items;
+    for (uint32_t count = in.u32(); count > 0; count--)
+      items.push_back(readExpr());
+    return items;
+  }
+  list<Stmt<T> *> readStmts() {
+    list<Stmt<T> *> items;
+    for (uint32_t count = in.u32(); count > 0; count--)
+      items.push_back(readStmt());
+    return items;
+  }
+  list<Token> readTokens() {
+    list<Token> items;
+    for (uint32_t count = in.u32(); count > 0; count--)
+      items.push_back(in.token());
+    return items;
+  }
+};
+#endif
@@ -3,7 +3,9 @@
 #include <string>
 #include <memory>
 #include <list>
+#include "../Arena.h"
 #include "../Lex.h"
+#include "../Quickening.h"
 #include "../Util.h"
 using namespace std;
 
@@ -47,11 +49,32 @@ public:
   virtual T visitExprAssign (Assign<T>* expr) = 0;
 };
 
+enum ExprKind {
+  EXPR_BINARY,
+  EXPR_CALL,
+  EXPR_GROUPING,
+  EXPR_LITERAL,
+  EXPR_LOGICAL,
+  EXPR_UNARY,
+  EXPR_VARIABLE,
+  EXPR_ASSIGN,
+};
+
 template <typename T>
 class Expr {
   public:
-  Expr( )  {}
+  ExprKind kind;
+  Expr( ExprKind kind) : kind(kind) {}
   virtual T accept (ExprAstVisitor<T>* visitor) = 0;
+  virtual ~Expr() {}
+  void *operator new (size_t size, Arena &arena) {
+    return arena.allocate(size, destroy);
+  }
+  void operator delete (void *, Arena &) {}
+  void operator delete (void *) {}
+  static void destroy (void *ptr) {
+    static_cast<Expr<T> *>(ptr)->~Expr();
+  }
 };
 
 template <typename T>
@@ -60,7 +83,9 @@ class Binary : public Expr<T> {
   Expr<T> * left;
   Token op;
   Expr<T> * right;
-  Binary( Expr<T> * left, Token op, Expr<T> * right) : left(left), op(op), right(right) {}
+  Quickening quick = QUICK_UNSEEN;
+  int deopts = 0;
+  Binary( Expr<T> * left, Token op, Expr<T> * right) : Expr<T>(EXPR_BINARY), left(left), op(op), right(right) {}
   T accept (ExprAstVisitor<T>* visitor) {
     return visitor->visitExprBinary(this);
   }
@@ -72,7 +97,7 @@ class Call : public Expr<T> {
   Expr<T> * callee;
   Token paren;
   list<Expr<T> *> arguments;
-  Call( Expr<T> * callee, Token paren, list<Expr<T> *> arguments) : callee(callee), paren(paren), arguments(arguments) {}
+  Call( Expr<T> * callee, Token paren, list<Expr<T> *> arguments) : Expr<T>(EXPR_CALL), callee(callee), paren(paren), arguments(arguments) {}
   T accept (ExprAstVisitor<T>* visitor) {
     return visitor->visitExprCall(this);
   }
@@ -82,7 +107,7 @@ template <typename T>
 class Grouping : public Expr<T> {
   public:
   Expr<T> * grouping;
-  Grouping( Expr<T> * grouping) : grouping(grouping) {}
+  Grouping( Expr<T> * grouping) : Expr<T>(EXPR_GROUPING), grouping(grouping) {}
   T accept (ExprAstVisitor<T>* visitor) {
     return visitor->visitExprGrouping(this);
   }
@@ -92,7 +117,7 @@ template <typename T>
 class Literal : public Expr<T> {
   public:
   Obj value;
-  Literal( Obj value) : value(value) {}
+  Literal( Obj value) : Expr<T>(EXPR_LITERAL), value(value) {}
   T accept (ExprAstVisitor<T>* visitor) {
     return visitor->visitExprLiteral(this);
   }
@@ -104,7 +129,9 @@ class Logical : public Expr<T> {
   Expr<T> * left;
   Token op;
   Expr<T> * right;
-  Logical( Expr<T> * left, Token op, Expr<T> * right) : left(left), op(op), right(right) {}
+  Quickening quick = QUICK_UNSEEN;
+  int deopts = 0;
+  Logical( Expr<T> * left, Token op, Expr<T> * right) : Expr<T>(EXPR_LOGICAL), left(left), op(op), right(right) {}
   T accept (ExprAstVisitor<T>* visitor) {
     return visitor->visitExprLogical(this);
   }
@@ -115,7 +142,9 @@ class Unary : public Expr<T> {
   public:
   Token op;
   Expr<T> * right;
-  Unary( Token op, Expr<T> * right) : op(op), right(right) {}
+  Quickening quick = QUICK_UNSEEN;
+  int deopts = 0;
+  Unary( Token op, Expr<T> * right) : Expr<T>(EXPR_UNARY), op(op), right(right) {}
   T accept (ExprAstVisitor<T>* visitor) {
     return visitor->visitExprUnary(this);
   }
@@ -125,7 +154,9 @@ template <typename T>
 class Variable : public Expr<T> {
   public:
   Token name;
-  Variable( Token name) : name(name) {}
+  int depth = -1;
+  int slot = -1;
+  Variable( Token name) : Expr<T>(EXPR_VARIABLE), name(name) {}
   T accept (ExprAstVisitor<T>* visitor) {
     return visitor->visitExprVariable(this);
   }
@@ -136,9 +167,34 @@ class Assign : public Expr<T> {
   public:
   Token name;
   Expr<T> * value;
-  Assign( Token name, Expr<T> * value) : name(name), value(value) {}
+  int depth = -1;
+  int slot = -1;
+  Assign( Token name, Expr<T> * value) : Expr<T>(EXPR_ASSIGN), name(name), value(value) {}
   T accept (ExprAstVisitor<T>* visitor) {
     return visitor->visitExprAssign(this);
   }
 };
+
+template <typename V, typename T>
+inline T dispatchExpr(V &visitor, Expr<T> *expr) {
+  switch (expr->kind) {
+  case EXPR_BINARY:
+    return visitor.visitExprBinary(static_cast<Binary<T> *>(expr));
+  case EXPR_CALL:
+    return visitor.visitExprCall(static_cast<Call<T> *>(expr));
+  case EXPR_GROUPING:
+    return visitor.visitExprGrouping(static_cast<Grouping<T> *>(expr));
+  case EXPR_LITERAL:
+    return visitor.visitExprLiteral(static_cast<Literal<T> *>(expr));
+  case EXPR_LOGICAL:
+    return visitor.visitExprLogical(static_cast<Logical<T> *>(expr));
+  case EXPR_UNARY:
+    return visitor.visitExprUnary(static_cast<Unary<T> *>(expr));
+  case EXPR_VARIABLE:
+    return visitor.visitExprVariable(static_cast<Variable<T> *>(expr));
+  case EXPR_ASSIGN:
+    return visitor.visitExprAssign(static_cast<Assign<T> *>(expr));
+  }
+  return T();
+}
 #endif
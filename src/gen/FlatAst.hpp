@@ -0,0 +1,305 @@
+#ifndef FLAT_AST_HPP
+#define FLAT_AST_HPP
+#include <cstdint>
+#include <list>
+#include <vector>
+#include "../Lex.h"
+#include "../Util.h"
+#include "Expr.hpp"
+#include "Stmt.hpp"
+using namespace std;
+
+// Reference to a node: its kind in the top bits, its index in the array
+// of that kind in FlatAst below
+typedef uint32_t FlatRef;
+#define FLAT_KIND_SHIFT 28
+#define FLAT_INDEX_MASK 0x0fffffff
+#define FLAT_NONE 0xffffffff
+
+inline FlatRef flatRef(uint32_t kind, uint32_t index) {
+  return kind << FLAT_KIND_SHIFT | index;
+}
+inline uint32_t flatKind(FlatRef ref) { return ref >> FLAT_KIND_SHIFT; }
+inline uint32_t flatIndex(FlatRef ref) { return ref & FLAT_INDEX_MASK; }
+
+// Consecutive entries of one of the FlatAst list arrays
+struct FlatSpan {
+  uint32_t begin;
+  uint32_t count;
+};
+
+enum FlatExprKind {
+  FLAT_BINARY,
+  FLAT_CALL,
+  FLAT_GROUPING,
+  FLAT_LITERAL,
+  FLAT_LOGICAL,
+  FLAT_UNARY,
+  FLAT_VARIABLE,
+  FLAT_ASSIGN,
+};
+
+enum FlatStmtKind {
+  FLAT_EXPRESSION,
+  FLAT_FUNCTION,
+  FLAT_IF,
+  FLAT_PRINT,
+  FLAT_RETURN,
+  FLAT_VAR,
+  FLAT_WHILE,
+  FLAT_BLOCK,
+};
+
+struct FlatBinary {
+  FlatRef left;
+  Token op;
+  FlatRef right;
+};
+
+struct FlatCall {
+  FlatRef callee;
+  Token paren;
+  FlatSpan arguments;
+};
+
+struct FlatGrouping {
+  FlatRef grouping;
+};
+
+struct FlatLiteral {
+  Obj value;
+};
+
+struct FlatLogical {
+  FlatRef left;
+  Token op;
+  FlatRef right;
+};
+
+struct FlatUnary {
+  Token op;
+  FlatRef right;
+};
+
+struct FlatVariable {
+  Token name;
+  int depth = -1;
+  int slot = -1;
+};
+
+struct FlatAssign {
+  Token name;
+  FlatRef value;
+  int depth = -1;
+  int slot = -1;
+};
+
+struct FlatExpression {
+  FlatRef expr;
+};
+
+struct FlatFunction {
+  Token name;
+  FlatSpan params;
+  FlatSpan body;
+};
+
+struct FlatIf {
+  FlatRef condition;
+  FlatRef thenBranch;
+  FlatRef elseBranch;
+};
+
+struct FlatPrint {
+  FlatRef expr;
+};
+
+struct FlatReturn {
+  Token keyword;
+  FlatRef value;
+};
+
+struct FlatVar {
+  Token name;
+  FlatRef initializer;
+};
+
+struct FlatWhile {
+  FlatRef condition;
+  FlatRef body;
+};
+
+struct FlatBlock {
+  FlatSpan statements;
+};
+
+class FlatAst {
+public:
+  vector<FlatBinary> binaryNodes;
+  vector<FlatCall> callNodes;
+  vector<FlatGrouping> groupingNodes;
+  vector<FlatLiteral> literalNodes;
+  vector<FlatLogical> logicalNodes;
+  vector<FlatUnary> unaryNodes;
+  vector<FlatVariable> variableNodes;
+  vector<FlatAssign> assignNodes;
+  vector<FlatExpression> expressionNodes;
+  vector<FlatFunction> functionNodes;
+  vector<FlatIf> ifNodes;
+  vector<FlatPrint> printNodes;
+  vector<FlatReturn> returnNodes;
+  vector<FlatVar> varNodes;
+  vector<FlatWhile> whileNodes;
+  vector<FlatBlock> blockNodes;
+  // Child lists, addressed by FlatSpan
+  vector<FlatRef> exprLists;
+  vector<FlatRef> stmtLists;
+  vector<Token> tokenLists;
+  // Top level statements, in stmtLists
+  FlatSpan script = {0, 0};
+};
+
+// Copies a pointer AST into a FlatAst, children before their parent
+template <typename T>
+class FlatBuilder : ExprAstVisitor<T>, StmtAstVisitor<T> {
+public:
+  FlatBuilder(FlatAst &ast) : ast(ast) {}
+  void build(const vector<Stmt<T> *> &stmts) {
+    ast.script = add(list<Stmt<T> *>(stmts.begin(), stmts.end()));
+  }
+  T visitExprBinary (Binary<T>* node) override {
+    FlatBinary flat = {add(node->left), node->op, add(node->right)};
+    ast.binaryNodes.push_back(flat);
+    ref = flatRef(FLAT_BINARY, ast.binaryNodes.size() - 1);
+    return T();
+  }
+  T visitExprCall (Call<T>* node) override {
+    FlatCall flat = {add(node->callee), node->paren, add(node->arguments)};
+    ast.callNodes.push_back(flat);
+    ref = flatRef(FLAT_CALL, ast.callNodes.size() - 1);
+    return T();
+  }
+  T visitExprGrouping (Grouping<T>* node) override {
+    FlatGrouping flat = {add(node->grouping)};
+    ast.groupingNodes.push_back(flat);
+    ref = flatRef(FLAT_GROUPING, ast.groupingNodes.size() - 1);
+    return T();
+  }
+  T visitExprLiteral (Literal<T>* node) override {
+    FlatLiteral flat = {node->value};
+    ast.literalNodes.push_back(flat);
+    ref = flatRef(FLAT_LITERAL, ast.literalNodes.size() - 1);
+    return T();
+  }
+  T visitExprLogical (Logical<T>* node) override {
+    FlatLogical flat = {add(node->left), node->op, add(node->right)};
+    ast.logicalNodes.push_back(flat);
+    ref = flatRef(FLAT_LOGICAL, ast.logicalNodes.size() - 1);
+    return T();
+  }
+  T visitExprUnary (Unary<T>* node) override {
+    FlatUnary flat = {node->op, add(node->right)};
+    ast.unaryNodes.push_back(flat);
+    ref = flatRef(FLAT_UNARY, ast.unaryNodes.size() - 1);
+    return T();
+  }
+  T visitExprVariable (Variable<T>* node) override {
+    FlatVariable flat = {node->name, node->depth, node->slot};
+    ast.variableNodes.push_back(flat);
+    ref = flatRef(FLAT_VARIABLE, ast.variableNodes.size() - 1);
+    return T();
+  }
+  T visitExprAssign (Assign<T>* node) override {
+    FlatAssign flat = {node->name, add(node->value), node->depth, node->slot};
+    ast.assignNodes.push_back(flat);
+    ref = flatRef(FLAT_ASSIGN, ast.assignNodes.size() - 1);
+    return T();
+  }
+  T visitStmtExpression (Expression<T>* node) override {
+    FlatExpression flat = {add(node->expr)};
+    ast.expressionNodes.push_back(flat);
+    ref = flatRef(FLAT_EXPRESSION, ast.expressionNodes.size() - 1);
+    return T();
+  }
+  T visitStmtFunction (Function<T>* node) override {
+    FlatFunction flat = {node->name, add(node->params), add(node->body)};
+    ast.functionNodes.push_back(flat);
+    ref = flatRef(FLAT_FUNCTION, ast.functionNodes.size() - 1);
+    return T();
+  }
+  T visitStmtIf (If<T>* node) override {
+    FlatIf flat = {add(node->condition), add(node->thenBranch), add(node->elseBranch)};
+    ast.ifNodes.push_back(flat);
+    ref = flatRef(FLAT_IF, ast.ifNodes.size() - 1);
+    return T();
+  }
+  T visitStmtPrint (Print<T>* node) override {
+    FlatPrint flat = {add(node->expr)};
+    ast.printNodes.push_back(flat);
+    ref = flatRef(FLAT_PRINT, ast.printNodes.size() - 1);
+    return T();
+  }
+  T visitStmtReturn (Return<T>* node) override {
+    FlatReturn flat = {node->keyword, add(node->value)};
+    ast.returnNodes.push_back(flat);
+    ref = flatRef(FLAT_RETURN, ast.returnNodes.size() - 1);
+    return T();
+  }
+  T visitStmtVar (Var<T>* node) override {
+    FlatVar flat = {node->name, add(node->initializer)};
+    ast.varNodes.push_back(flat);
+    ref = flatRef(FLAT_VAR, ast.varNodes.size() - 1);
+    return T();
+  }
+  T visitStmtWhile (While<T>* node) override {
+    FlatWhile flat = {add(node->condition), add(node->body)};
+    ast.whileNodes.push_back(flat);
+    ref = flatRef(FLAT_WHILE, ast.whileNodes.size() - 1);
+    return T();
+  }
+  T visitStmtBlock (Block<T>* node) override {
+    FlatBlock flat = {add(node->statements)};
+    ast.blockNodes.push_back(flat);
+    ref = flatRef(FLAT_BLOCK, ast.blockNodes.size() - 1);
+    return T();
+  }
+
+private:
+  FlatAst &ast;
+  // Reference to the node just added
+  FlatRef ref = FLAT_NONE;
+  FlatRef add(Expr<T> *node) {
+    if (node == nullptr)
+      return FLAT_NONE;
+    node->accept(this);
+    return ref;
+  }
+  FlatSpan add(const list<Expr<T> *> &nodes) {
+    vector<FlatRef> refs;
+    for (auto node : nodes)
+      refs.push_back(add(node));
+    FlatSpan span = {(uint32_t)ast.exprLists.size(), (uint32_t)refs.size()};
+    ast.exprLists.insert(ast.exprLists.end(), refs.begin(), refs.end());
+    return span;
+  }
+  FlatRef add(Stmt<T> *node) {
+    if (node == nullptr)
+      return FLAT_NONE;
+    node->accept(this);
+    return ref;
+  }
+  FlatSpan add(const list<Stmt<T> *> &nodes) {
+    vector<FlatRef> refs;
+    for (auto node : nodes)
+      refs.push_back(add(node));
+    FlatSpan span = {(uint32_t)ast.stmtLists.size(), (uint32_t)refs.size()};
+    ast.stmtLists.insert(ast.stmtLists.end(), refs.begin(), refs.end());
+    return span;
+  }
+  FlatSpan add(const list<Token> &tokens) {
+    FlatSpan span = {(uint32_t)ast.tokenLists.size(), (uint32_t)tokens.size()};
+    ast.tokenLists.insert(ast.tokenLists.end(), tokens.begin(), tokens.end());
+    return span;
+  }
+};
+#endif
@@ -3,6 +3,9 @@
 #include <string>
 #include <memory>
 #include <list>
+#include "../Arena.h"
+#include "../JitEntry.h"
+#include "../LazyBody.h"
 #include "../Lex.h"
 #include "../Util.h"
 #include "Expr.hpp"
@@ -48,18 +51,39 @@ public:
   virtual T visitStmtBlock (Block<T>* stmt) = 0;
 };
 
+enum StmtKind {
+  STMT_EXPRESSION,
+  STMT_FUNCTION,
+  STMT_IF,
+  STMT_PRINT,
+  STMT_RETURN,
+  STMT_VAR,
+  STMT_WHILE,
+  STMT_BLOCK,
+};
+
 template <typename T>
 class Stmt {
   public:
-  Stmt( )  {}
+  StmtKind kind;
+  Stmt( StmtKind kind) : kind(kind) {}
   virtual T accept (StmtAstVisitor<T>* visitor) = 0;
+  virtual ~Stmt() {}
+  void *operator new (size_t size, Arena &arena) {
+    return arena.allocate(size, destroy);
+  }
+  void operator delete (void *, Arena &) {}
+  void operator delete (void *) {}
+  static void destroy (void *ptr) {
+    static_cast<Stmt<T> *>(ptr)->~Stmt();
+  }
 };
 
 template <typename T>
 class Expression : public Stmt<T> {
   public:
   Expr<T> * expr;
-  Expression( Expr<T> * expr) : expr(expr) {}
+  Expression( Expr<T> * expr) : Stmt<T>(STMT_EXPRESSION), expr(expr) {}
   T accept (StmtAstVisitor<T>* visitor) {
     return visitor->visitStmtExpression(this);
   }
@@ -71,7 +95,10 @@ class Function : public Stmt<T> {
   Token name;
   list<Token> params;
   list<Stmt<T> *> body;
-  Function( Token name, list<Token> params, list<Stmt<T> *> body) : name(name), params(params), body(body) {}
+  int calls = 0;
+  JitEntry native = nullptr;
+  LazyBody * lazy = nullptr;
+  Function( Token name, list<Token> params, list<Stmt<T> *> body) : Stmt<T>(STMT_FUNCTION), name(name), params(params), body(body) {}
   T accept (StmtAstVisitor<T>* visitor) {
     return visitor->visitStmtFunction(this);
   }
@@ -83,7 +110,7 @@ class If : public Stmt<T> {
   Expr<T> * condition;
   Stmt<T> * thenBranch;
   Stmt<T> * elseBranch;
-  If( Expr<T> * condition, Stmt<T> * thenBranch, Stmt<T> * elseBranch) : condition(condition), thenBranch(thenBranch), elseBranch(elseBranch) {}
+  If( Expr<T> * condition, Stmt<T> * thenBranch, Stmt<T> * elseBranch) : Stmt<T>(STMT_IF), condition(condition), thenBranch(thenBranch), elseBranch(elseBranch) {}
   T accept (StmtAstVisitor<T>* visitor) {
     return visitor->visitStmtIf(this);
   }
@@ -93,7 +120,7 @@ template <typename T>
 class Print : public Stmt<T> {
   public:
   Expr<T> * expr;
-  Print( Expr<T> * expr) : expr(expr) {}
+  Print( Expr<T> * expr) : Stmt<T>(STMT_PRINT), expr(expr) {}
   T accept (StmtAstVisitor<T>* visitor) {
     return visitor->visitStmtPrint(this);
   }
@@ -104,7 +131,7 @@ class Return : public Stmt<T> {
   public:
   Token keyword;
   Expr<T> * value;
-  Return( Token keyword, Expr<T> * value) : keyword(keyword), value(value) {}
+  Return( Token keyword, Expr<T> * value) : Stmt<T>(STMT_RETURN), keyword(keyword), value(value) {}
   T accept (StmtAstVisitor<T>* visitor) {
     return visitor->visitStmtReturn(this);
   }
@@ -115,7 +142,7 @@ class Var : public Stmt<T> {
   public:
   Token name;
   Expr<T> * initializer;
-  Var( Token name, Expr<T> * initializer) : name(name), initializer(initializer) {}
+  Var( Token name, Expr<T> * initializer) : Stmt<T>(STMT_VAR), name(name), initializer(initializer) {}
   T accept (StmtAstVisitor<T>* visitor) {
     return visitor->visitStmtVar(this);
   }
@@ -126,7 +153,7 @@ class While : public Stmt<T> {
   public:
   Expr<T> * condition;
   Stmt<T> * body;
-  While( Expr<T> * condition, Stmt<T> * body) : condition(condition), body(body) {}
+  While( Expr<T> * condition, Stmt<T> * body) : Stmt<T>(STMT_WHILE), condition(condition), body(body) {}
   T accept (StmtAstVisitor<T>* visitor) {
     return visitor->visitStmtWhile(this);
   }
@@ -136,9 +163,32 @@ template <typename T>
 class Block : public Stmt<T> {
   public:
   list<Stmt<T> *> statements;
-  Block( list<Stmt<T> *> statements) : statements(statements) {}
+  Block( list<Stmt<T> *> statements) : Stmt<T>(STMT_BLOCK), statements(statements) {}
   T accept (StmtAstVisitor<T>* visitor) {
     return visitor->visitStmtBlock(this);
   }
 };
+
+template <typename V, typename T>
+inline T dispatchStmt(V &visitor, Stmt<T> *stmt) {
+  switch (stmt->kind) {
+  case STMT_EXPRESSION:
+    return visitor.visitStmtExpression(static_cast<Expression<T> *>(stmt));
+  case STMT_FUNCTION:
+    return visitor.visitStmtFunction(static_cast<Function<T> *>(stmt));
+  case STMT_IF:
+    return visitor.visitStmtIf(static_cast<If<T> *>(stmt));
+  case STMT_PRINT:
+    return visitor.visitStmtPrint(static_cast<Print<T> *>(stmt));
+  case STMT_RETURN:
+    return visitor.visitStmtReturn(static_cast<Return<T> *>(stmt));
+  case STMT_VAR:
+    return visitor.visitStmtVar(static_cast<Var<T> *>(stmt));
+  case STMT_WHILE:
+    return visitor.visitStmtWhile(static_cast<While<T> *>(stmt));
+  case STMT_BLOCK:
+    return visitor.visitStmtBlock(static_cast<Block<T> *>(stmt));
+  }
+  return T();
+}
 #endif
@@ -1,51 +1,258 @@
+#include <stdio.h>
 #include <stdlib.h>
 
-#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <climits>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "AstPrinter.h"
+#include "ClosureCompiler.h"
+#include "CompilationUnit.h"
+#include "Compiler.h"
+#include "CppEmitter.h"
+#include "FlatInterpreter.h"
+#include "Gc.h"
 #include "Interpreter.h"
+#include "Jit.h"
 #include "Lex.h"
+#include "Optimizer.h"
+#include "ParallelLexer.h"
+#include "ParallelParser.h"
 #include "Parser.h"
+#include "Resolver.h"
+#include "Scan.h"
+#include "ScriptCache.h"
+#include "Source.h"
+#include "TokenStream.h"
+#include "VM.h"
 #include "gen/Expr.hpp"
 
 typedef std::string string;
 
-static string readAllBytes(char const *filename) {
-  std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
-  if (!ifs.good())
-    exit(66);
+// Command line switches, shared by the REPL and script runs
+struct Options {
+  string engine = "tree";
+  bool cache = false;
+  bool dumpBytecode = false;
+  bool emitCpp = false;
+  bool gcStats = false;
+  bool lazyParse = false;
+  int lexJobs = 1;
+  bool optimize = false;
+  int parseJobs = 1;
+  bool quickeningStats = false;
+  bool stream = false;
+  bool time = false;
+};
+
+static Options options;
+
+// Reports how long each phase of a run took on stderr, for --time. A phase
+// lasts until the next one starts, the last one until the timer is destroyed
+class PhaseTimer {
+public:
+  PhaseTimer() : phase(nullptr), tokens(0) {}
+  ~PhaseTimer() { stop(); }
+
+  void start(const char *name) {
+    stop();
+    phase = name;
+    tokens = 0;
+    begin = std::chrono::steady_clock::now();
+  }
+
+  // Tokens handled by the current phase, reported as a throughput
+  void count(size_t handled) { tokens = handled; }
+
+private:
+  const char *phase;
+  size_t tokens;
+  std::chrono::steady_clock::time_point begin;
+
+  void stop() {
+    if (!options.time || phase == nullptr)
+      return;
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - begin;
+    double seconds = elapsed.count();
+    fprintf(stderr, "%-9s %10.3f ms", phase, seconds * 1000);
+    if (tokens > 0)
+      fprintf(stderr, " %10zu tokens %12.0f tokens/s", tokens,
+              tokens / seconds);
+    fprintf(stderr, "\n");
+    phase = nullptr;
+  }
+};
+
+// Lexes and parses the unit's source into its statements, true on errors.
+// Lazy leaves top-level function bodies to be parsed on their first call
+static bool parse(CompilationUnit &unit, bool lazy, PhaseTimer &timer) {
+  // Streamed tokens are lexed as the Parser asks for them, so both phases
+  // are timed as one and no token vector is kept
+  if (options.stream) {
+    timer.start("parse");
+    Lexer lexer(unit.src);
+    TokenStream tokens(lexer);
+    Parser<Obj> parser(tokens, unit.arena);
+    unit.statements = parser.parse();
+    timer.count(tokens.lexed());
+    return parser.err || lexer.err;
+  }
+
+  timer.start("lex");
+  ParallelLexer scan(unit.src, options.lexJobs);
+  scan.getTokens();
+  timer.count(scan.tokens.size());
+  if (scan.err)
+    return true;
+  unit.tokens = std::move(scan.tokens);
 
-  std::ifstream::pos_type pos = ifs.tellg();
+  timer.start("parse");
+  timer.count(unit.tokens.size());
+  ParallelParser parser(unit, options.parseJobs);
+  parser.lazy = lazy;
+  unit.statements = parser.parse();
+  return parser.err;
+}
+
+// Parses, resolves and runs one top-level statement at a time, pulling tokens
+// from a TokenStream, so a script starts running before it has all been read.
+// After a syntax error the rest is still parsed to report its errors, but
+// nothing more is resolved or run. A runtime error stops everything
+static bool runStreaming(CompilationUnit &unit, PhaseTimer &timer) {
+  timer.start("run");
+  Lexer lexer(unit.src);
+  TokenStream tokens(lexer);
+  Parser<Obj> parser(tokens, unit.arena);
+  Resolver resolver;
+  Interpreter interpreter;
+  interpreter.quickeningStats = options.quickeningStats;
 
-  std::vector<char> val(pos);
+  while (!interpreter.err && tokens.peek().type != EOF_TOK) {
+    Stmt<Obj> *statement = parser.declaration();
+    if (statement == nullptr)
+      continue;
 
-  ifs.seekg(0, std::ios::beg);
-  ifs.read(&val[0], pos);
+    // Kept by the unit, functions declared here are called later on
+    unit.statements.push_back(statement);
+    // A statement with syntax errors may hold nulls the Resolver can't walk
+    if (parser.err || lexer.err)
+      continue;
+
+    resolver.resolve(vector<Stmt<Obj> *>{statement});
+    if (!resolver.err)
+      interpreter.interpret({statement});
+  }
+  timer.count(tokens.lexed());
 
-  return string(val.begin(), val.end());
+  if (options.quickeningStats)
+    interpreter.printQuickeningStats();
+  return parser.err || lexer.err || resolver.err || interpreter.err;
 }
 
-bool run(string src) {
+bool run(Source src, const string &cachePath = "") {
   bool err = false;
 
-  Lexer *scan = new Lexer(src);
-  scan->getTokens();
-  err &= scan->err;
-  if (err)
-    return true;
+  // Declared first so it is released last, after the engine that ran it
+  CompilationUnit unit(std::move(src));
+  auto &statements = unit.statements;
+  PhaseTimer timer;
+
+  // A cache made from the same source stands in for the Lexer and Parser
+  ScriptCache cache(cachePath);
+  // Deferred bodies are only understood by the tree Interpreter, and must
+  // not end up in the cache or the passes that walk every function
+  bool lazy = options.lazyParse && !options.stream &&
+              options.engine == "tree" && !options.optimize &&
+              !options.emitCpp && cachePath.empty();
 
-  Parser<Obj> *parser = new Parser<Obj>(scan->tokens);
-  auto statements = parser->parse();
-  err &= parser->err;
+  if (options.stream && options.engine == "tree" && !options.optimize &&
+      !options.emitCpp && cachePath.empty())
+    return runStreaming(unit, timer);
+
+  bool cached = false;
+  if (!cachePath.empty()) {
+    timer.start("cache");
+    cached = cache.load(unit.src, unit.arena, statements);
+  }
+
+  if (!cached) {
+    if (parse(unit, lazy, timer))
+      return true;
+    if (!cachePath.empty()) {
+      timer.start("store");
+      cache.store(unit.src, statements);
+    }
+  }
+
+  timer.start("resolve");
+  Resolver resolver;
+  resolver.resolve(statements);
+  err |= resolver.err;
   if (err)
     return true;
 
-  Interpreter *interpreter = new Interpreter();
-  interpreter->interpret(statements);
-  err &= interpreter->err;
+  if (options.optimize) {
+    timer.start("optimize");
+    Optimizer optimizer(unit.arena);
+    statements = optimizer.optimize(statements);
+  }
+
+  if (options.emitCpp) {
+    timer.start("emit");
+    CppEmitter emitter;
+    std::cout << emitter.emit(statements);
+    return false;
+  }
+
+  if (options.engine == "vm") {
+    timer.start("compile");
+    Compiler compiler;
+    std::unique_ptr<VmFunction> script = compiler.compile(statements);
+    err |= compiler.err;
+    if (err)
+      return true;
+
+    if (options.dumpBytecode)
+      script->chunk.disassemble(script->name);
+
+    timer.start("run");
+    VM vm;
+    vm.interpret(script.get());
+    err |= vm.err;
+    return err;
+  }
+
+  if (options.engine == "flat") {
+    timer.start("flatten");
+    FlatAst ast;
+    FlatBuilder<Obj>(ast).build(statements);
+    timer.start("run");
+    FlatInterpreter engine(ast);
+    engine.interpret();
+    return engine.err;
+  }
+
+  if (options.engine == "closure") {
+    timer.start("run");
+    ClosureCompiler engine;
+    engine.interpret(statements);
+    return engine.err;
+  }
+
+  timer.start("run");
+  Interpreter interpreter;
+  interpreter.quickeningStats = options.quickeningStats;
+  interpreter.interpret(statements);
+  err |= interpreter.err;
+
+  if (options.quickeningStats)
+    interpreter.printQuickeningStats();
   if (err)
     return true;
 
@@ -63,15 +270,26 @@ int repl() {
       break;
     }
 
-    run(line);
+    run(Source(line));
   }
 
+  if (options.gcStats)
+    gc().printStats();
+
   return 0;
 }
 
+// Runs a script file, or stdin for "-"
 int runFile(const string &path) {
-  string src = readAllBytes(path.data());
-  bool err = run(src);
+  Source src;
+  if (!src.load(path.data()))
+    exit(66);
+
+  bool useCache = options.cache && path != "-";
+  bool err = run(std::move(src), useCache ? path + ".loxc" : "");
+
+  if (options.gcStats)
+    gc().printStats();
 
   if (err)
     exit(65);
@@ -79,15 +297,86 @@ int runFile(const string &path) {
   return 0;
 }
 
+static void usage() {
+  std::cout << "Usage: cpplox [--engine=tree|vm|closure|flat] [-O] [--cache] "
+               "[--dump-bytecode] [--emit-cpp] [--gc-threshold=BYTES] "
+               "[--gc-growth=FACTOR] [--gc-stats] [--lazy-parse] "
+               "[--quickening-stats] [--no-jit] [--jit-threshold=CALLS] "
+               "[--lex-jobs=THREADS] [--parse-jobs=THREADS] "
+               "[--scan=auto|scalar|sse2|avx2] [--stream] [--time] [script|-]"
+            << std::endl;
+  exit(64);
+}
+
+// Value of a --flag=NUMBER switch
+static double parseNumber(const string &arg) {
+  try {
+    size_t used;
+    string value = arg.substr(arg.find('=') + 1);
+    double number = std::stod(value, &used);
+    if (used == value.size() && number >= 0)
+      return number;
+  } catch (const std::exception &) {
+  }
+
+  usage();
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
-  if (argc > 2) {
-    std::cout << "Usage: cpplox [script]" << std::endl;
-    exit(64);
-  } else if (argc == 2) {
-    runFile(argv[1]);
-  } else {
-    repl();
+  const char *script = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+
+    if (arg == "--engine=tree" || arg == "--engine=vm" ||
+        arg == "--engine=closure" || arg == "--engine=flat")
+      options.engine = arg.substr(arg.find('=') + 1);
+    else if (arg == "-O")
+      options.optimize = true;
+    else if (arg == "--cache")
+      options.cache = true;
+    else if (arg == "--dump-bytecode")
+      options.dumpBytecode = true;
+    else if (arg == "--emit-cpp")
+      options.emitCpp = true;
+    else if (arg.rfind("--gc-threshold=", 0) == 0)
+      gc().threshold = parseNumber(arg);
+    else if (arg.rfind("--gc-growth=", 0) == 0)
+      gc().growth = parseNumber(arg);
+    else if (arg == "--stream")
+      options.stream = true;
+    else if (arg == "--lazy-parse")
+      options.lazyParse = true;
+    else if (arg == "--gc-stats")
+      options.gcStats = true;
+    else if (arg.rfind("--lex-jobs=", 0) == 0)
+      options.lexJobs = std::max(1.0, parseNumber(arg));
+    else if (arg.rfind("--parse-jobs=", 0) == 0)
+      options.parseJobs = std::max(1.0, parseNumber(arg));
+    else if (arg.rfind("--scan=", 0) == 0) {
+      if (!selectScanKernels(arg.substr(arg.find('=') + 1)))
+        usage();
+    } else if (arg == "--time")
+      options.time = true;
+    else if (arg == "--quickening-stats")
+      options.quickeningStats = true;
+    else if (arg == "--no-jit")
+      jit().enabled = false;
+    else if (arg.rfind("--jit-threshold=", 0) == 0)
+      // 0 compiles on the first call like 1 does, --no-jit turns it off
+      jit().threshold = std::min((double)INT_MAX,
+                                 std::max(1.0, parseNumber(arg)));
+    else if ((arg != "-" && arg.rfind("-", 0) == 0) || script != nullptr)
+      usage();
+    else
+      script = argv[i];
   }
 
+  if (script != nullptr)
+    runFile(script);
+  else
+    repl();
+
   exit(0);
 }
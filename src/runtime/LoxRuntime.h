@@ -0,0 +1,264 @@
+#ifndef LOX_RUNTIME_H
+#define LOX_RUNTIME_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+// Runtime for the C++ that `cpplox --emit-cpp` generates. It only depends on
+// the standard library, so a generated program builds on its own:
+//
+//   clang++ -std=c++17 -O2 -I src/runtime script.cpp -o script
+//
+// Behaviour mirrors the tree-walking interpreter, including its output
+// formats and error messages, so a generated binary can be checked against
+// it. Heap values are reference counted, a closure that refers to itself
+// through a captured variable is never freed.
+
+enum LoxType {
+  LOX_UNDEFINED,
+  LOX_NIL,
+  LOX_BOOL,
+  LOX_NUMBER,
+  LOX_STRING,
+  LOX_FUNCTION
+};
+
+class LoxObject {
+public:
+  virtual ~LoxObject() {}
+};
+
+class LoxString : public LoxObject {
+public:
+  string value;
+
+  LoxString(string value) : value(std::move(value)) {}
+};
+
+class LoxValue {
+public:
+  LoxType type;
+  union {
+    bool boolean;
+    double number;
+  };
+  shared_ptr<LoxObject> object;
+
+  LoxValue() : type(LOX_NIL), number(0) {}
+  LoxValue(bool value) : type(LOX_BOOL), boolean(value) {}
+  LoxValue(double value) : type(LOX_NUMBER), number(value) {}
+  LoxValue(LoxType type, shared_ptr<LoxObject> object)
+      : type(type), number(0), object(std::move(object)) {}
+
+  bool isNumber() const { return type == LOX_NUMBER; }
+  bool isString() const { return type == LOX_STRING; }
+  const string &asString() const {
+    return static_cast<LoxString *>(object.get())->value;
+  }
+};
+
+typedef function<LoxValue(const LoxValue *)> LoxBody;
+
+class LoxFunction : public LoxObject {
+public:
+  int arity;
+  LoxBody body;
+
+  LoxFunction(int arity, LoxBody body) : arity(arity), body(std::move(body)) {}
+};
+
+// Variables captured by a closure live on the heap, shared by every function
+// that refers to them
+typedef shared_ptr<LoxValue> LoxCell;
+
+// Operands are passed as one braced list so they are evaluated left to
+// right, function arguments have no defined order
+struct LoxOperands {
+  LoxValue left;
+  LoxValue right;
+};
+
+class LoxError {
+public:
+  int line;
+  string message;
+
+  LoxError(int line, string message) : line(line), message(std::move(message)) {}
+};
+
+// ----------------------------------------
+// Values
+inline LoxValue loxUndefined() {
+  LoxValue value;
+  value.type = LOX_UNDEFINED;
+  return value;
+}
+
+// NaNs and infinities can't be written as literals, the emitter passes
+// their bits
+inline double loxBits(uint64_t bits) {
+  double value;
+  memcpy(&value, &bits, sizeof(double));
+  return value;
+}
+
+inline LoxValue loxString(string value) {
+  return LoxValue(LOX_STRING, make_shared<LoxString>(std::move(value)));
+}
+
+inline LoxValue loxFunction(int arity, LoxBody body) {
+  return LoxValue(LOX_FUNCTION, make_shared<LoxFunction>(arity, std::move(body)));
+}
+
+inline LoxCell loxCell(LoxValue value) { return make_shared<LoxValue>(value); }
+
+inline LoxValue loxClock() {
+  return loxFunction(0, [](const LoxValue *) -> LoxValue {
+    return chrono::duration_cast<chrono::milliseconds>(
+               chrono::system_clock::now().time_since_epoch())
+               .count() /
+           1000.0;
+  });
+}
+
+inline bool loxTruthy(const LoxValue &value) {
+  if (value.type == LOX_NIL)
+    return false;
+  if (value.type == LOX_BOOL)
+    return value.boolean;
+  return true;
+}
+
+// Functions print as nil, like in the interpreter
+inline string loxToString(const LoxValue &value) {
+  switch (value.type) {
+  case LOX_STRING:
+    return value.asString();
+  case LOX_NUMBER:
+    return to_string(value.number);
+  case LOX_BOOL:
+    return value.boolean ? "true" : "false";
+  default:
+    return "nil";
+  }
+}
+
+inline void loxPrint(const LoxValue &value) {
+  cout << loxToString(value) << '\n';
+}
+
+// ----------------------------------------
+// Variables
+inline const LoxValue &loxGlobal(const LoxValue &global, const char *name,
+                                 int line) {
+  if (global.type == LOX_UNDEFINED)
+    throw LoxError(line, string("Undefined variable '") + name + "'.");
+  return global;
+}
+
+inline LoxValue loxAssignGlobal(LoxValue &global, LoxValue value,
+                                const char *name, int line) {
+  if (global.type == LOX_UNDEFINED)
+    throw LoxError(line, string("Undefined variable '") + name + "'.");
+  return global = std::move(value);
+}
+
+// ----------------------------------------
+// Operators
+inline void loxCheckNumbers(const LoxOperands &operands, int line) {
+  if (!operands.left.isNumber() || !operands.right.isNumber())
+    throw LoxError(line, "Operand must be a number!");
+}
+
+#define LOX_NUMBER_OPERATOR(name, op)                                          \
+  inline LoxValue name(const LoxOperands &operands, int line) {                \
+    loxCheckNumbers(operands, line);                                           \
+    return operands.left.number op operands.right.number;                      \
+  }
+
+LOX_NUMBER_OPERATOR(loxSubtract, -)
+LOX_NUMBER_OPERATOR(loxMultiply, *)
+LOX_NUMBER_OPERATOR(loxDivide, /)
+LOX_NUMBER_OPERATOR(loxGreater, >)
+LOX_NUMBER_OPERATOR(loxGreaterEqual, >=)
+LOX_NUMBER_OPERATOR(loxLess, <)
+LOX_NUMBER_OPERATOR(loxLessEqual, <=)
+
+#undef LOX_NUMBER_OPERATOR
+
+inline LoxValue loxAdd(const LoxOperands &operands, int line) {
+  const LoxValue &left = operands.left, &right = operands.right;
+  if (left.isNumber() && right.isNumber())
+    return left.number + right.number;
+  if (left.isString() && right.isString())
+    return loxString(left.asString() + right.asString());
+  throw LoxError(line, "Operands must be two numbers or strings");
+}
+
+inline bool loxEqual(const LoxOperands &operands) {
+  const LoxValue &left = operands.left, &right = operands.right;
+  if (left.type != right.type)
+    return false;
+
+  switch (left.type) {
+  case LOX_BOOL:
+    return left.boolean == right.boolean;
+  case LOX_NUMBER:
+    return left.number == right.number;
+  case LOX_STRING:
+    return left.object == right.object || left.asString() == right.asString();
+  case LOX_FUNCTION:
+    return left.object == right.object;
+  default:
+    return true;
+  }
+}
+
+// The parser accepts '!' between two operands, the interpreter evaluates both
+// and yields nil
+inline LoxValue loxNil(const LoxOperands &) { return LoxValue(); }
+
+inline LoxValue loxNegate(const LoxValue &value, int line) {
+  if (!value.isNumber())
+    throw LoxError(line, "Operand must be a number!");
+  return -value.number;
+}
+
+// The callee comes first in the list, followed by the arguments
+inline LoxValue loxCall(initializer_list<LoxValue> values, int line) {
+  const LoxValue &callee = *values.begin();
+  if (callee.type != LOX_FUNCTION)
+    throw LoxError(line, "Can only call functions and classes.");
+
+  auto function = static_cast<LoxFunction *>(callee.object.get());
+  int count = values.size() - 1;
+  if (count != function->arity)
+    throw LoxError(line, "Expected " + to_string(function->arity) +
+                             " arguments but got " + to_string(count) + ".");
+
+  return function->body(values.begin() + 1);
+}
+
+// ----------------------------------------
+// Entry point, exits like `cpplox script` does
+inline int loxMain(void (*script)()) {
+  try {
+    script();
+  } catch (const LoxError &error) {
+    cout << "[line " << error.line << "] " << error.message << endl;
+    return 65;
+  }
+
+  cout.flush();
+  return 0;
+}
+
+#endif
@@ -0,0 +1,91 @@
+"""Compile Lox scripts ahead of time and compare them with the interpreter.
+
+Each script goes through `cpplox --emit-cpp`, the result is built with the
+runtime in src/runtime, and the native binary must print exactly what the
+interpreter prints, including runtime errors and the exit status.
+
+    python3 tooling/aot.py samples/fib.txt
+    python3 tooling/aot.py --cxx g++ --runs 5 samples/fib.txt samples/loops.txt
+
+Scripts whose output depends on timing, like samples/recursion.txt which
+prints a call rate, never match and are left out. `make bench-aot` runs the
+deterministic samples listed in AOT_SAMPLES.
+"""
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import time
+
+from bench import run_once
+
+RUNTIME = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                       "..", "src", "runtime")
+
+
+def default_cxx():
+    if os.environ.get("CXX"):
+        return os.environ["CXX"]
+    return shutil.which("clang++") or "g++"
+
+
+def best_of(cmd, runs):
+    best, out, code = None, b"", 0
+    for _ in range(runs):
+        elapsed, _, out, code = run_once(cmd)
+        best = elapsed if best is None else min(best, elapsed)
+    return best, out, code
+
+
+def compile_script(args, script):
+    name = os.path.splitext(os.path.basename(script))[0]
+    source = os.path.join(args.build_dir, name + ".cpp")
+    binary = os.path.join(args.build_dir, name)
+
+    with open(source, "wb") as out:
+        subprocess.run([args.binary, "--emit-cpp", script], stdout=out, check=True)
+
+    start = time.perf_counter()
+    subprocess.run([args.cxx, "-std=c++17", "-O2", "-I", RUNTIME, source,
+                    "-o", binary], check=True)
+    return binary, time.perf_counter() - start
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument("scripts", nargs="+")
+    parser.add_argument("--binary", default="./cpplox.out",
+                        help="interpreter used to emit and as reference")
+    parser.add_argument("--cxx", default=default_cxx(),
+                        help="C++ compiler for the generated code (default $CXX, clang++ or g++)")
+    parser.add_argument("--build-dir", default="aot_build",
+                        help="where generated sources and binaries go")
+    parser.add_argument("--runs", type=int, default=3,
+                        help="runs per script, the best one is reported")
+    args = parser.parse_args()
+
+    os.makedirs(args.build_dir, exist_ok=True)
+    mismatch = False
+
+    print(f"{'script':<28} {'interp (s)':>10} {'native (s)':>10} "
+          f"{'speedup':>8} {'build (s)':>10}")
+    for script in args.scripts:
+        binary, build = compile_script(args, script)
+        interp, expected, expected_code = best_of([args.binary, script], args.runs)
+        native, out, code = best_of([binary], args.runs)
+
+        note = ""
+        if out != expected or code != expected_code:
+            note = "  OUTPUT DIFFERS"
+            mismatch = True
+
+        print(f"{script:<28} {interp:>10.3f} {native:>10.3f} "
+              f"{interp / native:>7.1f}x {build:>10.2f}{note}")
+
+    sys.exit(1 if mismatch else 0)
+
+
+if __name__ == "__main__":
+    main()
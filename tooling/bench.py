@@ -0,0 +1,79 @@
+"""Time cpplox on sample scripts, optionally under several flag sets.
+
+Every configuration of a script must print the same output, so comparing
+engines or optimization flags doubles as a sanity check.
+
+    python3 tooling/bench.py samples/fib.txt
+    python3 tooling/bench.py --binary old.out --binary ./cpplox.out samples/*.txt
+    python3 tooling/bench.py --config tree= --config vm=--engine=vm samples/*.txt
+"""
+import argparse
+import os
+import shlex
+import subprocess
+import sys
+import time
+
+
+def run_once(cmd):
+    start = time.perf_counter()
+    with subprocess.Popen(cmd, stdout=subprocess.PIPE,
+                          stderr=subprocess.STDOUT) as proc:
+        out = proc.stdout.read()
+        _, status, usage = os.wait4(proc.pid, 0)
+        proc.returncode = os.waitstatus_to_exitcode(status)
+    elapsed = time.perf_counter() - start
+    return elapsed, usage.ru_maxrss, out, proc.returncode
+
+
+def parse_configs(binaries, configs):
+    parsed = []
+    for binary in binaries:
+        for config in configs:
+            name, _, flags = config.partition("=")
+            if len(binaries) > 1:
+                name = os.path.basename(binary) + ":" + name
+            parsed.append((name, [binary] + shlex.split(flags)))
+    return parsed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument("scripts", nargs="+")
+    parser.add_argument("--binary", action="append",
+                        help="interpreter to run, can be repeated (default ./cpplox.out)")
+    parser.add_argument("--config", action="append",
+                        help="NAME=FLAGS passed before the script, can be repeated")
+    parser.add_argument("--runs", type=int, default=3,
+                        help="runs per configuration, the best one is reported")
+    args = parser.parse_args()
+
+    configs = parse_configs(args.binary or ["./cpplox.out"],
+                            args.config or ["default="])
+    mismatch = False
+
+    print(f"{'script':<28} {'config':<28} {'best (s)':>10} {'max rss (KB)':>14}")
+    for script in args.scripts:
+        expected = None
+        for name, cmd in configs:
+            best, rss, out = None, 0, b""
+            for _ in range(args.runs):
+                elapsed, maxrss, out, _ = run_once(cmd + [script])
+                best = elapsed if best is None else min(best, elapsed)
+                rss = max(rss, maxrss)
+
+            note = ""
+            if expected is None:
+                expected = out
+            elif out != expected:
+                note = "  OUTPUT DIFFERS"
+                mismatch = True
+
+            print(f"{script:<28} {name:<28} {best:>10.3f} {rss:>14}{note}")
+
+    sys.exit(1 if mismatch else 0)
+
+
+if __name__ == "__main__":
+    main()
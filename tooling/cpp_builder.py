@@ -49,10 +49,15 @@ class CppBuilder:
         self.add_ws(1)
         self.append_src(" public:")
 
-        # Gen class attributes
-        for field_type, field_name in fields:
+        # Gen class attributes, fields with a default value are filled in by
+        # later passes and are left out of the constructor
+        for field in fields:
             self.add_ws(2)
-            self.append_src(field_type + " " + field_name + ";")
+            if len(field) > 2:
+                self.append_src(field[0] + " " + field[1] + " = " + field[2] + ";")
+            else:
+                self.append_src(field[0] + " " + field[1] + ";")
+        fields = [field for field in fields if len(field) == 2]
 
         # Gen constructor
         self.add_ws(2)
@@ -66,11 +71,13 @@ class CppBuilder:
         else:
             constructor = constructor + ") "
 
-        # Intizalize fields
-        for i, (field_type, field_name) in enumerate(fields):
-            constructor = constructor + field_name + "(" + field_name + ")"
-            if (i < len(fields)-1):
-                constructor = constructor + ", "
+        # Intizalize fields, derived nodes pass their kind tag to the base
+        inits = [field_name + "(" + field_name + ")" for _, field_name in fields]
+        if parent != "":
+            inits = [parent + "<T>(" + self.kind_name(parent, name) + ")"] + inits
+            if len(fields) == 0:
+                constructor = constructor.rstrip() + " : "
+        constructor = constructor + ", ".join(inits)
 
         constructor = constructor + " {}"
         self.append_src(constructor)
@@ -80,6 +87,7 @@ class CppBuilder:
         # Check if it's base class or not
         if parent == "":
             self.append_src("virtual T accept (" + name + "AstVisitor<T>*" + " visitor) = 0;")
+            self.build_arena_allocation(name)
         else:
             self.append_src("T accept (" + parent + "AstVisitor<T>*" + " visitor) {")
             self.add_ws(4)
@@ -89,6 +97,63 @@ class CppBuilder:
 
         self.append_src("};")
 
+    def build_arena_allocation(self, name):
+        # Nodes are placement-allocated from the Arena of their compilation
+        # unit, which runs their destructor when it is released. Nodes only
+        # use single inheritance, so the base sits at the start of the object
+        self.add_ws(2)
+        self.append_src("virtual ~" + name + "() {}")
+        self.add_ws(2)
+        self.append_src("void *operator new (size_t size, Arena &arena) {")
+        self.add_ws(4)
+        self.append_src("return arena.allocate(size, destroy);")
+        self.add_ws(2)
+        self.append_src("}")
+        self.add_ws(2)
+        self.append_src("void operator delete (void *, Arena &) {}")
+        # Never freed one by one, the Arena releases all nodes together
+        self.add_ws(2)
+        self.append_src("void operator delete (void *) {}")
+        self.add_ws(2)
+        self.append_src("static void destroy (void *ptr) {")
+        self.add_ws(4)
+        self.append_src("static_cast<" + name + "<T> *>(ptr)->~" + name + "();")
+        self.add_ws(2)
+        self.append_src("}")
+
+    @staticmethod
+    def kind_name(base_name, type_name):
+        return base_name.upper() + "_" + type_name.upper()
+
+    def build_kinds(self, base_name, ast_types):
+        # Tag stored in every node, lets engines dispatch with a switch
+        self.append_src("enum " + base_name + "Kind {")
+        for type_name, _ in ast_types:
+            self.add_ws(2)
+            self.append_src(self.kind_name(base_name, type_name) + ",")
+        self.append_src("};")
+
+    def build_dispatch(self, base_name, ast_types):
+        # Non-virtual alternative to accept. Called on a final visitor the
+        # visit is a direct call the compiler can inline
+        var = base_name.lower()
+        self.append_src("template <typename V, typename T>")
+        self.append_src("inline T dispatch" + base_name + "(V &visitor, " + base_name +
+                        "<T> *" + var + ") {")
+        self.add_ws(2)
+        self.append_src("switch (" + var + "->kind) {")
+        for type_name, _ in ast_types:
+            self.add_ws(2)
+            self.append_src("case " + self.kind_name(base_name, type_name) + ":")
+            self.add_ws(4)
+            self.append_src("return visitor.visit" + base_name + type_name + "(static_cast<" +
+                            type_name + "<T> *>(" + var + "));")
+        self.add_ws(2)
+        self.append_src("}")
+        self.add_ws(2)
+        self.append_src("return T();")
+        self.append_src("}")
+
     def build_visitor(self, base_name, ast_types):
         self.build_template_header("T")
 
@@ -105,6 +170,369 @@ class CppBuilder:
         self.append_src("};")
 
 
+    # ----------------------------------------
+    # Flat layout, see build_flat_ast
+
+    # Field types of the pointer AST that become references or spans, every
+    # other field is copied as is
+    FLAT_TYPES = {
+        "Expr<T> *": "FlatRef",
+        "Stmt<T> *": "FlatRef",
+        "list<Expr<T> *>": "FlatSpan",
+        "list<Stmt<T> *>": "FlatSpan",
+        "list<Token>": "FlatSpan",
+    }
+
+    # Runtime state the tree Interpreter and the JIT keep in the nodes. The
+    # flat engine uses none of it, so it stays out of the flat layout
+    FLAT_SKIPPED = ("quick", "deopts", "calls", "native", "lazy")
+
+    def build_flat_ast(self, expr_types, stmt_types):
+        self.append_src("// Reference to a node: its kind in the top bits, its index in the array")
+        self.append_src("// of that kind in FlatAst below")
+        self.append_src("typedef uint32_t FlatRef;")
+        self.append_src("#define FLAT_KIND_SHIFT 28")
+        self.append_src("#define FLAT_INDEX_MASK 0x0fffffff")
+        self.append_src("#define FLAT_NONE 0xffffffff")
+        self.build_nl()
+        self.append_src("inline FlatRef flatRef(uint32_t kind, uint32_t index) {")
+        self.add_ws(2)
+        self.append_src("return kind << FLAT_KIND_SHIFT | index;")
+        self.append_src("}")
+        self.append_src("inline uint32_t flatKind(FlatRef ref) { return ref >> FLAT_KIND_SHIFT; }")
+        self.append_src("inline uint32_t flatIndex(FlatRef ref) { return ref & FLAT_INDEX_MASK; }")
+        self.build_nl()
+        self.append_src("// Consecutive entries of one of the FlatAst list arrays")
+        self.append_src("struct FlatSpan {")
+        self.add_ws(2)
+        self.append_src("uint32_t begin;")
+        self.add_ws(2)
+        self.append_src("uint32_t count;")
+        self.append_src("};")
+
+        for base_name, ast_types in (("Expr", expr_types), ("Stmt", stmt_types)):
+            self.build_nl()
+            self.append_src("enum Flat" + base_name + "Kind {")
+            for type_name, _ in ast_types:
+                self.add_ws(2)
+                self.append_src("FLAT_" + type_name.upper() + ",")
+            self.append_src("};")
+
+        for type_name, fields in expr_types + stmt_types:
+            self.build_nl()
+            self.build_flat_struct(type_name, fields)
+
+        self.build_nl()
+        self.build_flat_container(expr_types + stmt_types)
+        self.build_nl()
+        self.build_flat_builder(expr_types, stmt_types)
+
+    def build_flat_struct(self, name, fields):
+        self.append_src("struct Flat" + name + " {")
+        for field in fields:
+            if field[1] in self.FLAT_SKIPPED:
+                continue
+            field_type = self.FLAT_TYPES.get(field[0], field[0])
+            self.add_ws(2)
+            if len(field) > 2:
+                self.append_src(field_type + " " + field[1] + " = " + field[2] + ";")
+            else:
+                self.append_src(field_type + " " + field[1] + ";")
+        self.append_src("};")
+
+    def build_flat_container(self, ast_types):
+        self.append_src("class FlatAst {")
+        self.append_src("public:")
+        for type_name, _ in ast_types:
+            self.add_ws(2)
+            self.append_src("vector<Flat" + type_name + "> " +
+                            type_name[0].lower() + type_name[1:] + "Nodes;")
+        self.add_ws(2)
+        self.append_src("// Child lists, addressed by FlatSpan")
+        self.add_ws(2)
+        self.append_src("vector<FlatRef> exprLists;")
+        self.add_ws(2)
+        self.append_src("vector<FlatRef> stmtLists;")
+        self.add_ws(2)
+        self.append_src("vector<Token> tokenLists;")
+        self.add_ws(2)
+        self.append_src("// Top level statements, in stmtLists")
+        self.add_ws(2)
+        self.append_src("FlatSpan script = {0, 0};")
+        self.append_src("};")
+
+    def build_flat_builder(self, expr_types, stmt_types):
+        self.append_src("// Copies a pointer AST into a FlatAst, children before their parent")
+        self.build_template_header("T")
+        self.append_src("class FlatBuilder : ExprAstVisitor<T>, StmtAstVisitor<T> {")
+        self.append_src("public:")
+        self.add_ws(2)
+        self.append_src("FlatBuilder(FlatAst &ast) : ast(ast) {}")
+        self.add_ws(2)
+        self.append_src("void build(const vector<Stmt<T> *> &stmts) {")
+        self.add_ws(4)
+        self.append_src("ast.script = add(list<Stmt<T> *>(stmts.begin(), stmts.end()));")
+        self.add_ws(2)
+        self.append_src("}")
+
+        for base_name, ast_types in (("Expr", expr_types), ("Stmt", stmt_types)):
+            for type_name, fields in ast_types:
+                nodes = "ast." + type_name[0].lower() + type_name[1:] + "Nodes"
+                values = []
+                for field in fields:
+                    if field[1] in self.FLAT_SKIPPED:
+                        continue
+                    if field[0] in self.FLAT_TYPES:
+                        values.append("add(node->" + field[1] + ")")
+                    else:
+                        values.append("node->" + field[1])
+                self.add_ws(2)
+                self.append_src("T visit" + base_name + type_name + " (" + type_name +
+                                "<T>* node) override {")
+                # A braced list evaluates in order, so children keep source order
+                self.add_ws(4)
+                self.append_src("Flat" + type_name + " flat = {" + ", ".join(values) + "};")
+                self.add_ws(4)
+                self.append_src(nodes + ".push_back(flat);")
+                self.add_ws(4)
+                self.append_src("ref = flatRef(FLAT_" + type_name.upper() + ", " +
+                                nodes + ".size() - 1);")
+                self.add_ws(4)
+                self.append_src("return T();")
+                self.add_ws(2)
+                self.append_src("}")
+
+        self.append_src("")
+        self.append_src("private:")
+        self.add_ws(2)
+        self.append_src("FlatAst &ast;")
+        self.add_ws(2)
+        self.append_src("// Reference to the node just added")
+        self.add_ws(2)
+        self.append_src("FlatRef ref = FLAT_NONE;")
+        for base_name in ("Expr", "Stmt"):
+            self.add_ws(2)
+            self.append_src("FlatRef add(" + base_name + "<T> *node) {")
+            self.add_ws(4)
+            self.append_src("if (node == nullptr)")
+            self.add_ws(6)
+            self.append_src("return FLAT_NONE;")
+            self.add_ws(4)
+            self.append_src("node->accept(this);")
+            self.add_ws(4)
+            self.append_src("return ref;")
+            self.add_ws(2)
+            self.append_src("}")
+            # Children are added before the span is reserved, so their own
+            # lists can't end up in the middle of it
+            self.add_ws(2)
+            self.append_src("FlatSpan add(const list<" + base_name + "<T> *> &nodes) {")
+            self.add_ws(4)
+            self.append_src("vector<FlatRef> refs;")
+            self.add_ws(4)
+            self.append_src("for (auto node : nodes)")
+            self.add_ws(6)
+            self.append_src("refs.push_back(add(node));")
+            self.add_ws(4)
+            lists = "ast." + base_name.lower() + "Lists"
+            self.append_src("FlatSpan span = {(uint32_t)" + lists + ".size(), (uint32_t)refs.size()};")
+            self.add_ws(4)
+            self.append_src(lists + ".insert(" + lists + ".end(), refs.begin(), refs.end());")
+            self.add_ws(4)
+            self.append_src("return span;")
+            self.add_ws(2)
+            self.append_src("}")
+        self.add_ws(2)
+        self.append_src("FlatSpan add(const list<Token> &tokens) {")
+        self.add_ws(4)
+        self.append_src("FlatSpan span = {(uint32_t)ast.tokenLists.size(), (uint32_t)tokens.size()};")
+        self.add_ws(4)
+        self.append_src("ast.tokenLists.insert(ast.tokenLists.end(), tokens.begin(), tokens.end());")
+        self.add_ws(4)
+        self.append_src("return span;")
+        self.add_ws(2)
+        self.append_src("}")
+        self.append_src("};")
+
+    # ----------------------------------------
+    # Script cache, see src/ScriptCache.h
+
+    # How each stored field type is read back from a CacheReader
+    CACHE_READERS = {
+        "Expr<T> *": "readExpr()",
+        "Stmt<T> *": "readStmt()",
+        "list<Expr<T> *>": "readExprs()",
+        "list<Stmt<T> *>": "readStmts()",
+        "list<Token>": "readTokens()",
+        "Token": "in.token()",
+        "Obj": "in.value()",
+        "int": "(int)in.u32()",
+    }
+
+    @staticmethod
+    def stored_fields(fields):
+        # Fields with a default are filled in by later passes, the cache keeps
+        # what the parser produced
+        return [field for field in fields if len(field) == 2]
+
+    def build_cache_layout(self, expr_types, stmt_types):
+        # FNV-1a of the stored fields, a cache written for other nodes is stale
+        layout = 0x811c9dc5
+        for type_name, fields in expr_types + stmt_types:
+            text = type_name + "(" + ",".join(
+                t + " " + n for t, n in self.stored_fields(fields)) + ")"
+            for byte in text.encode("utf-8"):
+                layout = ((layout ^ byte) * 0x01000193) & 0xffffffff
+        self.append_src("// Changes whenever the nodes or their stored fields do")
+        self.append_src("#define AST_CACHE_LAYOUT 0x%08xu" % layout)
+
+    def build_ast_writer(self, expr_types, stmt_types):
+        self.append_src("// Writes nodes in pre-order: a tag, 0 for null and kind + 1 otherwise,")
+        self.append_src("// followed by the stored fields")
+        self.build_template_header("T")
+        self.append_src("class AstWriter : ExprAstVisitor<T>, StmtAstVisitor<T> {")
+        self.append_src("public:")
+        self.add_ws(2)
+        self.append_src("AstWriter(CacheWriter &out) : out(out) {}")
+        self.add_ws(2)
+        self.append_src("void write(const vector<Stmt<T> *> &stmts) {")
+        self.add_ws(4)
+        self.append_src("out.u32(stmts.size());")
+        self.add_ws(4)
+        self.append_src("for (auto stmt : stmts)")
+        self.add_ws(6)
+        self.append_src("write(stmt);")
+        self.add_ws(2)
+        self.append_src("}")
+
+        for base_name, ast_types in (("Expr", expr_types), ("Stmt", stmt_types)):
+            for type_name, fields in ast_types:
+                self.add_ws(2)
+                self.append_src("T visit" + base_name + type_name + " (" + type_name +
+                                "<T>* node) override {")
+                for _, field_name in self.stored_fields(fields):
+                    self.add_ws(4)
+                    self.append_src("write(node->" + field_name + ");")
+                self.add_ws(4)
+                self.append_src("return T();")
+                self.add_ws(2)
+                self.append_src("}")
+
+        self.append_src("")
+        self.append_src("private:")
+        self.add_ws(2)
+        self.append_src("CacheWriter &out;")
+        for base_name in ("Expr", "Stmt"):
+            self.add_ws(2)
+            self.append_src("void write(" + base_name + "<T> *node) {")
+            self.add_ws(4)
+            self.append_src("if (node == nullptr) {")
+            self.add_ws(6)
+            self.append_src("out.u8(0);")
+            self.add_ws(6)
+            self.append_src("return;")
+            self.add_ws(4)
+            self.append_src("}")
+            self.add_ws(4)
+            self.append_src("out.u8(node->kind + 1);")
+            self.add_ws(4)
+            self.append_src("node->accept(this);")
+            self.add_ws(2)
+            self.append_src("}")
+        self.add_ws(2)
+        self.append_src("template <typename Item> void write(const list<Item> &items) {")
+        self.add_ws(4)
+        self.append_src("out.u32(items.size());")
+        self.add_ws(4)
+        self.append_src("for (auto &item : items)")
+        self.add_ws(6)
+        self.append_src("write(item);")
+        self.add_ws(2)
+        self.append_src("}")
+        for arg in ("const Token &value", "Obj value", "int value"):
+            self.add_ws(2)
+            self.append_src("void write(" + arg + ") { out.write(value); }")
+        self.append_src("};")
+
+    def build_ast_reader(self, expr_types, stmt_types):
+        self.append_src("// Rebuilds in an Arena what AstWriter wrote, a malformed stream makes the")
+        self.append_src("// CacheReader throw")
+        self.build_template_header("T")
+        self.append_src("class AstReader {")
+        self.append_src("public:")
+        self.add_ws(2)
+        self.append_src("AstReader(CacheReader &in, Arena &arena) : in(in), arena(arena) {}")
+        self.add_ws(2)
+        self.append_src("vector<Stmt<T> *> read() {")
+        self.add_ws(4)
+        self.append_src("vector<Stmt<T> *> stmts;")
+        self.add_ws(4)
+        self.append_src("for (uint32_t count = in.u32(); count > 0; count--)")
+        self.add_ws(6)
+        self.append_src("stmts.push_back(readStmt());")
+        self.add_ws(4)
+        self.append_src("return stmts;")
+        self.add_ws(2)
+        self.append_src("}")
+        self.append_src("")
+        self.append_src("private:")
+        self.add_ws(2)
+        self.append_src("CacheReader &in;")
+        self.add_ws(2)
+        self.append_src("Arena &arena;")
+
+        for base_name, ast_types in (("Expr", expr_types), ("Stmt", stmt_types)):
+            self.add_ws(2)
+            self.append_src(base_name + "<T> *read" + base_name + "() {")
+            self.add_ws(4)
+            self.append_src("uint8_t tag = in.u8();")
+            self.add_ws(4)
+            self.append_src("if (tag == 0)")
+            self.add_ws(6)
+            self.append_src("return nullptr;")
+            self.build_nl()
+            self.add_ws(4)
+            self.append_src("switch (tag - 1) {")
+            for type_name, fields in ast_types:
+                self.add_ws(4)
+                self.append_src("case " + self.kind_name(base_name, type_name) + ": {")
+                # One statement per field keeps the stream order
+                stored = self.stored_fields(fields)
+                for field_type, field_name in stored:
+                    self.add_ws(6)
+                    self.append_src("auto " + field_name + " = " +
+                                    self.CACHE_READERS[field_type] + ";")
+                self.add_ws(6)
+                self.append_src("return new (arena) " + type_name + "<T>(" +
+                                ", ".join(n for _, n in stored) + ");")
+                self.add_ws(4)
+                self.append_src("}")
+            self.add_ws(4)
+            self.append_src("default:")
+            self.add_ws(6)
+            self.append_src("in.fail();")
+            self.add_ws(4)
+            self.append_src("}")
+            self.add_ws(2)
+            self.append_src("}")
+
+        for name, item, reader in (("readExprs", "Expr<T> *", "readExpr()"),
+                                   ("readStmts", "Stmt<T> *", "readStmt()"),
+                                   ("readTokens", "Token", "in.token()")):
+            self.add_ws(2)
+            self.append_src("list<" + item + "> " + name + "() {")
+            self.add_ws(4)
+            self.append_src("list<" + item + "> items;")
+            self.add_ws(4)
+            self.append_src("for (uint32_t count = in.u32(); count > 0; count--)")
+            self.add_ws(6)
+            self.append_src("items.push_back(" + reader + ");")
+            self.add_ws(4)
+            self.append_src("return items;")
+            self.add_ws(2)
+            self.append_src("}")
+        self.append_src("};")
+
     def gen(self):
         self.append_src("#endif")
 
@@ -0,0 +1,61 @@
+"""Write a large generated Lox script to stdout, for startup benchmarks.
+
+The script is a library of independent top-level functions and globals, of
+which only a handful are called, like the generated libraries it stands in for.
+With --data every function also gets a comment block and a long string.
+
+    python3 tooling/gen_script.py --functions 20000 > /tmp/big.lox
+    python3 tooling/gen_script.py --data > /tmp/data.lox
+"""
+import argparse
+
+FUNCTION = '''fun f{i}(a, b) {{
+  // helper number {i}
+  var total = a * {i} + b;
+  var label = "function {i} says: " + "hello";
+  for (var k = 0; k < b; k = k + 1) {{
+    if (total > {i}) {{
+      total = total - (k + 1) / 2;
+    }} else {{
+      total = total + k * 3;
+    }}
+  }}
+  while (total > 1000) total = total / 2;
+  return total;
+}}
+var g{i} = {i} * 2 + 1;
+'''
+
+DATA = '''
+// ------------------------------------------------------------------------
+// Record {i}. Generated table data follows, kept as a literal so the script
+// can be shipped as a single file. Do not edit by hand.
+// ------------------------------------------------------------------------
+var d{i} = "id={i};name=record number {i};tags=alpha,beta,gamma,delta;notes=
+this record was exported from the reference data set and is kept verbatim
+with its line breaks;checksum=0123456789abcdef0123456789abcdef";
+
+'''
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument("--functions", type=int, default=10000)
+    parser.add_argument("--calls", type=int, default=10,
+                        help="how many of the functions are actually called")
+    parser.add_argument("--data", action="store_true",
+                        help="add comment blocks and long string literals")
+    args = parser.parse_args()
+
+    for i in range(args.functions):
+        if args.data:
+            print(DATA.format(i=i), end="")
+        print(FUNCTION.format(i=i), end="")
+
+    step = max(1, args.functions // max(1, args.calls))
+    for i in range(0, args.functions, step)[:args.calls]:
+        print(f"print f{i}(g{i}, 3);")
+
+
+if __name__ == "__main__":
+    main()
@@ -5,7 +5,9 @@ expr_ast_types = [
     ("Binary", [
         ("Expr<T> *", "left"),
         ("Token", "op"),
-        ("Expr<T> *", "right")
+        ("Expr<T> *", "right"),
+        ("Quickening", "quick", "QUICK_UNSEEN"),
+        ("int", "deopts", "0")
     ]),
     ("Call", [
         ("Expr<T> *", "callee"),
@@ -21,18 +23,26 @@ expr_ast_types = [
     ("Logical", [
         ("Expr<T> *", "left"),
         ("Token", "op"),
-        ("Expr<T> *", "right")
+        ("Expr<T> *", "right"),
+        ("Quickening", "quick", "QUICK_UNSEEN"),
+        ("int", "deopts", "0")
     ]),
     ("Unary", [
         ("Token", "op"),
-        ("Expr<T> *", "right")
+        ("Expr<T> *", "right"),
+        ("Quickening", "quick", "QUICK_UNSEEN"),
+        ("int", "deopts", "0")
     ]),
     ("Variable", [
-        ("Token", "name")
+        ("Token", "name"),
+        ("int", "depth", "-1"),
+        ("int", "slot", "-1")
     ]),
     ("Assign", [
         ("Token", "name"),
-        ("Expr<T> *", "value")
+        ("Expr<T> *", "value"),
+        ("int", "depth", "-1"),
+        ("int", "slot", "-1")
     ])
 ]
 
@@ -44,6 +54,9 @@ stmt_ast_types = [
         ("Token", "name"),
         ("list<Token>", "params"),
         ("list<Stmt<T> *>", "body"),
+        ("int", "calls", "0"),
+        ("JitEntry", "native", "nullptr"),
+        ("LazyBody *", "lazy", "nullptr")
     ]),
     ("If", [
         ("Expr<T> *", "condition"),
@@ -78,7 +91,9 @@ builder = CppBuilder(file_path + "/" + "Expr.hpp", "EXPR_HPP")
 builder.build_include("<string>")
 builder.build_include("<memory>")
 builder.build_include("<list>")
+builder.build_include("\"../Arena.h\"")
 builder.build_include("\"../Lex.h\"")
+builder.build_include("\"../Quickening.h\"")
 builder.build_include("\"../Util.h\"")
 builder.build_using_namespace("std")
 
@@ -89,12 +104,18 @@ builder.build_forward([("Expr", [])])
 builder.build_visitor("Expr", expr_ast_types)
 
 builder.build_nl()
-builder.build_class(base_name, "", [])
+builder.build_kinds("Expr", expr_ast_types)
+
+builder.build_nl()
+builder.build_class(base_name, "", [("ExprKind", "kind")])
 
 for name, fields in expr_ast_types:
     builder.build_nl()
     builder.build_class(name, "Expr", fields)
 
+builder.build_nl()
+builder.build_dispatch("Expr", expr_ast_types)
+
 builder.gen()
 
 # Stmt files
@@ -103,6 +124,9 @@ builder = CppBuilder(file_path + "/" + "Stmt.hpp", "STMT_HPP")
 builder.build_include("<string>")
 builder.build_include("<memory>")
 builder.build_include("<list>")
+builder.build_include("\"../Arena.h\"")
+builder.build_include("\"../JitEntry.h\"")
+builder.build_include("\"../LazyBody.h\"")
 builder.build_include("\"../Lex.h\"")
 builder.build_include("\"../Util.h\"")
 builder.build_include("\"Expr.hpp\"")
@@ -115,10 +139,53 @@ builder.build_forward([("Stmt", [])])
 builder.build_visitor("Stmt", stmt_ast_types)
 
 builder.build_nl()
-builder.build_class(base_name, "", [])
+builder.build_kinds("Stmt", stmt_ast_types)
+
+builder.build_nl()
+builder.build_class(base_name, "", [("StmtKind", "kind")])
 
 for name, fields in stmt_ast_types:
     builder.build_nl()
     builder.build_class(name, "Stmt", fields)
 
+builder.build_nl()
+builder.build_dispatch("Stmt", stmt_ast_types)
+
+builder.gen()
+
+# Flat layout of the same nodes, one array per node type with children
+# referenced by 32-bit indices, for engines that walk it instead of pointers
+builder = CppBuilder(file_path + "/" + "FlatAst.hpp", "FLAT_AST_HPP")
+builder.build_include("<cstdint>")
+builder.build_include("<list>")
+builder.build_include("<vector>")
+builder.build_include("\"../Lex.h\"")
+builder.build_include("\"../Util.h\"")
+builder.build_include("\"Expr.hpp\"")
+builder.build_include("\"Stmt.hpp\"")
+builder.build_using_namespace("std")
+
+builder.build_nl()
+builder.build_flat_ast(expr_ast_types, stmt_ast_types)
+
+builder.gen()
+
+# Serialization of the parsed tree for the on-disk script cache
+builder = CppBuilder(file_path + "/" + "AstCache.hpp", "AST_CACHE_HPP")
+builder.build_include("<cstdint>")
+builder.build_include("<list>")
+builder.build_include("<vector>")
+builder.build_include("\"../Arena.h\"")
+builder.build_include("\"../CacheStream.h\"")
+builder.build_include("\"Expr.hpp\"")
+builder.build_include("\"Stmt.hpp\"")
+builder.build_using_namespace("std")
+
+builder.build_nl()
+builder.build_cache_layout(expr_ast_types, stmt_ast_types)
+builder.build_nl()
+builder.build_ast_writer(expr_ast_types, stmt_ast_types)
+builder.build_nl()
+builder.build_ast_reader(expr_ast_types, stmt_ast_types)
+
 builder.gen()
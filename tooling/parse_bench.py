@@ -0,0 +1,105 @@
+"""Measure lexer and parser throughput in tokens per second.
+
+Runs cpplox with --time and reports the best lex and parse rates over several
+runs. Without scripts, one is generated with gen_script.py. With --jobs N the
+lexer and parser run on 1 to N threads (--lex-jobs and --parse-jobs) and
+their speedups over one thread are reported.
+
+    python3 tooling/parse_bench.py
+    python3 tooling/parse_bench.py --binary old.out --binary ./cpplox.out
+    python3 tooling/parse_bench.py --functions 5000 samples/conformance.txt
+    python3 tooling/parse_bench.py --jobs 8
+    python3 tooling/parse_bench.py --data --config scalar=--scan=scalar \
+        --config avx2=--scan=avx2
+"""
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+from bench import parse_configs
+
+GEN_SCRIPT = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                          "gen_script.py")
+PHASES = ("lex", "parse")
+
+
+def phase_rates(cmd):
+    proc = subprocess.run(cmd, stdout=subprocess.DEVNULL,
+                          stderr=subprocess.PIPE, check=False)
+    rates = {}
+    for line in proc.stderr.decode().splitlines():
+        fields = line.split()
+        if len(fields) == 7 and fields[0] in PHASES and fields[6] == "tokens/s":
+            rates[fields[0]] = (int(fields[3]), float(fields[5]))
+    return rates
+
+
+def generate(functions, data):
+    with tempfile.NamedTemporaryFile("w", prefix="generated-", suffix=".lox",
+                                     delete=False) as out:
+        subprocess.run([sys.executable, GEN_SCRIPT, "--functions",
+                        str(functions)] + (["--data"] if data else []),
+                       stdout=out, check=True)
+    return out.name
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument("scripts", nargs="*")
+    parser.add_argument("--binary", action="append",
+                        help="interpreter to run, can be repeated (default ./cpplox.out)")
+    parser.add_argument("--config", action="append",
+                        help="NAME=FLAGS passed before the script, can be repeated")
+    parser.add_argument("--functions", type=int, default=20000,
+                        help="size of the generated script when none is given")
+    parser.add_argument("--data", action="store_true",
+                        help="generate comment blocks and long strings too")
+    parser.add_argument("--runs", type=int, default=5,
+                        help="runs per binary, the best rate is reported")
+    parser.add_argument("--jobs", type=int,
+                        help="time parsing on 1 to JOBS threads")
+    args = parser.parse_args()
+
+    scripts = args.scripts or [generate(args.functions, args.data)]
+    configs = parse_configs(args.binary or ["./cpplox.out"],
+                            args.config or ["default="])
+    # Binaries from before --lex-jobs and --parse-jobs only run without them
+    sweep = [[f"--lex-jobs={jobs}", f"--parse-jobs={jobs}"]
+             for jobs in range(1, args.jobs + 1)] if args.jobs else [[]]
+
+    print(f"{'script':<28} {'config':<16} {'jobs':>4} {'tokens':>10} "
+          f"{'lex (tok/s)':>14} {'speedup':>8} "
+          f"{'parse (tok/s)':>14} {'speedup':>8}")
+    try:
+        for script in scripts:
+            name = os.path.basename(script)
+            if not args.scripts:
+                name = f"generated ({args.functions} functions)"
+
+            for config, cmd in configs:
+                single = None
+                for flags in sweep:
+                    tokens, best = 0, dict.fromkeys(PHASES, 0.0)
+                    for _ in range(args.runs):
+                        for phase, (count, rate) in phase_rates(
+                                cmd + ["--time"] + flags + [script]).items():
+                            tokens = count
+                            best[phase] = max(best[phase], rate)
+
+                    single = single or best
+                    speedup = {phase: best[phase] / single[phase]
+                               if single[phase] else 0 for phase in PHASES}
+                    jobs = flags[0].partition("=")[2] if flags else "-"
+                    print(f"{name:<28} {config:<16} {jobs:>4} {tokens:>10} "
+                          f"{best['lex']:>14.0f} {speedup['lex']:>7.2f}x "
+                          f"{best['parse']:>14.0f} {speedup['parse']:>7.2f}x")
+    finally:
+        if not args.scripts:
+            os.unlink(scripts[0])
+
+
+if __name__ == "__main__":
+    main()